@@ -0,0 +1,57 @@
+/* cmake.h.in. Creates cmake.h during a cmake run */
+
+/* Product identification */
+#define PRODUCT_TASKSERVER 1
+
+/* Feature enable/disabled */
+#define FEATURE_API_INTERFACE
+
+/* Package information */
+#define PACKAGE           "taskd"
+#define VERSION           "1.2.0"
+#define PACKAGE_BUGREPORT "support@gothenburgbitfactory.org"
+#define PACKAGE_NAME      "taskd"
+#define PACKAGE_TARNAME   "taskd"
+#define PACKAGE_VERSION   "1.2.0"
+#define PACKAGE_STRING    "taskd 1.2.0"
+
+#define CMAKE_BUILD_TYPE  "Debug"
+
+/* Installation details */
+#define TASKD_EXTDIR "/usr/local/libexec/taskd"
+
+/* git information */
+#define HAVE_COMMIT
+
+/* cmake information */
+#define HAVE_CMAKE
+#define CMAKE_VERSION "3.25.1"
+
+/* Compiling platform */
+#define LINUX
+/* #undef DARWIN */
+/* #undef KFREEBSD */
+/* #undef FREEBSD */
+/* #undef OPENBSD */
+/* #undef NETBSD */
+/* #undef DRAGONFLY */
+/* #undef SOLARIS */
+/* #undef GNUHURD */
+/* #undef CYGWIN */
+/* #undef UNKNOWN */
+
+/* Found tm.tm_gmtoff struct member */
+#define HAVE_TM_GMTOFF
+
+/* Found st.st_birthtime struct member */
+/* #undef HAVE_ST_BIRTHTIME */
+
+/* Functions */
+#define HAVE_GET_CURRENT_DIR_NAME
+#define HAVE_TIMEGM
+#define HAVE_UUID_UNPARSE_LOWER
+
+/* Libraries */
+#define HAVE_LIBGNUTLS
+#define HAVE_LIBZ
+
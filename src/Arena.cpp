@@ -0,0 +1,96 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2010 - 2018, Göteborg Bit Factory.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// http://www.opensource.org/licenses/mit-license.php
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cmake.h>
+#include <Arena.h>
+#include <stdint.h>
+
+////////////////////////////////////////////////////////////////////////////////
+Arena::Arena (size_t block /* = 65536 */)
+: _block (block)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Arena::~Arena ()
+{
+  release ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Requests larger than a quarter block get a block of their own, so that a
+// growing vector does not strand most of a shared block.
+void* Arena::allocate (size_t bytes, size_t alignment)
+{
+  auto address = reinterpret_cast <uintptr_t> (_next);
+  auto padding = (alignment - address % alignment) % alignment;
+
+  if (! _next ||
+      padding + bytes > (size_t) (_end - _next))
+  {
+    auto size = bytes + alignment;
+    if (size < _block / 4)
+      size = _block;
+
+    auto block = static_cast <char*> (::operator new (size));
+    _blocks.push_back (block);
+
+    // Keep carving from the current block if the new one is dedicated.
+    if (size == _block || ! _next)
+    {
+      _next = block;
+      _end  = block + size;
+    }
+    else
+    {
+      address = reinterpret_cast <uintptr_t> (block);
+      padding = (alignment - address % alignment) % alignment;
+      _allocated += bytes;
+      return block + padding;
+    }
+
+    address = reinterpret_cast <uintptr_t> (_next);
+    padding = (alignment - address % alignment) % alignment;
+  }
+
+  auto result = _next + padding;
+  _next = result + bytes;
+  _allocated += bytes;
+  return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void Arena::release ()
+{
+  for (auto& block : _blocks)
+    ::operator delete (block);
+
+  _blocks.clear ();
+  _next = _end = nullptr;
+  _allocated = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
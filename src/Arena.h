@@ -0,0 +1,95 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2010 - 2018, Göteborg Bit Factory.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// http://www.opensource.org/licenses/mit-license.php
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef INCLUDED_ARENA
+#define INCLUDED_ARENA
+
+#include <vector>
+#include <cstddef>
+#include <new>
+
+// A monotonic region of memory.  Allocations are carved from large blocks,
+// individual deallocation is a no-op, and everything is released at once when
+// the arena is destroyed.  This suits the containers of a single request, which
+// all die together.  An Arena is not thread-safe, so each request owns one.
+class Arena
+{
+public:
+  explicit Arena (size_t block = 65536);
+  Arena (const Arena&) = delete;
+  Arena& operator= (const Arena&) = delete;
+  ~Arena ();
+
+  void* allocate (size_t, size_t);
+  void release ();
+  size_t allocated () const { return _allocated; }
+
+private:
+  std::vector <char*> _blocks {};
+  char* _next                 {nullptr};
+  char* _end                  {nullptr};
+  size_t _block;
+  size_t _allocated           {0};
+};
+
+// A C++11 allocator drawing from an Arena.  A default-constructed allocator has
+// no arena, and uses the global heap, so that containers using it can still be
+// created where no arena is at hand.
+template <class T>
+class ArenaAllocator
+{
+public:
+  typedef T value_type;
+
+  ArenaAllocator () = default;
+  ArenaAllocator (Arena& arena) : _arena (&arena) {}
+  template <class U> ArenaAllocator (const ArenaAllocator <U>& other) : _arena (other._arena) {}
+
+  T* allocate (size_t n)
+  {
+    if (_arena)
+      return static_cast <T*> (_arena->allocate (n * sizeof (T), alignof (T)));
+
+    return static_cast <T*> (::operator new (n * sizeof (T)));
+  }
+
+  void deallocate (T* p, size_t)
+  {
+    if (! _arena)
+      ::operator delete (p);
+  }
+
+  template <class U> bool operator== (const ArenaAllocator <U>& other) const { return _arena == other._arena; }
+  template <class U> bool operator!= (const ArenaAllocator <U>& other) const { return _arena != other._arena; }
+
+  Arena* _arena {nullptr};
+};
+
+template <class T>
+using ArenaVector = std::vector <T, ArenaAllocator <T>>;
+
+#endif
+////////////////////////////////////////////////////////////////////////////////
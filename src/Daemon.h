@@ -0,0 +1,130 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2010 - 2018, Göteborg Bit Factory.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// http://www.opensource.org/licenses/mit-license.php
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef INCLUDED_DAEMON
+#define INCLUDED_DAEMON
+
+#include <vector>
+#include <string>
+#include <map>
+#include <unordered_set>
+#include <ConfigFile.h>
+#include <Datetime.h>
+#include <Database.h>
+#include <Server.h>
+#include <Task.h>
+#include <Msg.h>
+#include <MsgView.h>
+#include <TxData.h>
+#include <Arena.h>
+#include <RateLimiter.h>
+#include <util.h>
+
+// A set of task UUIDs.  Canonical UUIDs are held as 128-bit values, and any
+// other UUID that passed validation is held as text.
+class UUIDSet
+{
+public:
+  explicit UUIDSet (Arena&);
+  bool insert (const std::string&);
+  bool contains (const std::string&) const;
+
+private:
+  std::unordered_set <UUID128, UUID128Hash, std::equal_to <UUID128>, ArenaAllocator <UUID128>> _values;
+  ArenaVector <std::string> _other;
+};
+
+class Daemon : public Server
+{
+public:
+  // Called on entry to (true) and exit from (false) each phase of a sync.
+  typedef void (*phase_hook) (const char*, bool);
+
+  Daemon (Config&);
+  void handler (const std::string& input, std::string& output);
+  bool admit (const std::string&, std::string&, int, double);
+  bool admitAddress (const std::string&, std::string&);
+  void setPhaseHook (phase_hook);
+
+  // The merge engine, public for the benchmarks.
+  void merge_sort (const std::vector <Task>&, const std::vector <Task>&, Task&) const;
+  void patch (Task&, const Task&, const Task&) const;
+  void diff (const Task&, const Task&, std::vector <std::string>&, std::vector <std::string>&, std::vector <std::string>&) const;
+
+private:
+  void handle_statistics (const MsgView&, Msg&);
+  void handle_sync       (const MsgView&, Msg&);
+
+private:
+  void configure_admission ();
+  void charge (const std::string&, const std::string&);
+  void decompress_request (MsgView&);
+  void compress_response (const MsgView&, Msg&);
+  void parse_payload (const StringView&, bool, ArenaVector <StringView>&, std::string&) const;
+  void load_server_data (const std::string&, const std::string&, TxData&) const;
+  void append_server_data (const std::string&, const std::string&, const ArenaVector <std::string>&) const;
+  unsigned int find_branch_point (const TxData&, const std::string&) const;
+  void extract_subset (const TxData&, const unsigned int, ArenaVector <Task>&) const;
+  std::string generate_payload (const ArenaVector <Task>&, const ArenaVector <std::string>&, const std::string&, bool) const;
+  std::string generate_delta_payload (const TxData&, unsigned int, const ArenaVector <Task>&, const ArenaVector <std::string>&, const ArenaVector <Task>&, const std::string&, bool) const;
+  void get_prior_versions (const TxData&, unsigned int, const ArenaVector <Task>&, std::map <std::string, Task>&) const;
+  std::string compose_delta (const Task&, const Task&) const;
+  unsigned int find_common_ancestor (const TxData&, unsigned int, const std::string&) const;
+  void get_client_mods (std::vector <Task>&, const ArenaVector <StringView>&, const std::string&) const;
+  void get_server_mods (std::vector <Task>&, const TxData&, const std::string&, unsigned int) const;
+  time_t last_modification (const Task&) const;
+  void get_totals (long&, long&, long&);
+  void phase (const char*, bool) const;
+
+public:
+  Database _db;
+
+private:
+  Config& _config;
+  Datetime _start    {Datetime ()};
+  long _txn_count    {0};
+  long _error_count  {0};
+  double _busy       {0.0};
+  double _max_time   {0.0};
+  long _bytes_in     {0};
+  long _bytes_out    {0};
+  long _compressed   {0};
+  long _raw_bytes    {0};
+  long _packed_bytes {0};
+  double _pack_time  {0.0};
+  phase_hook _phase  {nullptr};
+
+  // Admission control, shared with the accepting threads.
+  std::mutex _admission_mutex {};
+  int _max_pending            {0};
+  RateLimiter _address_limits {};
+  RateLimiter _org_limits     {};
+  RateLimiter _user_limits    {};
+  long _refused_count         {0};
+};
+
+#endif
+////////////////////////////////////////////////////////////////////////////////
@@ -63,10 +63,30 @@ bool Database::authenticate (
   const Msg& request,
   Msg& response)
 {
-  auto org  = request.get ("org");
-  auto user = request.get ("user");
-  auto key  = request.get ("key");
+  return authenticate (request.get ("org"),
+                       request.get ("user"),
+                       request.get ("key"),
+                       response);
+}
 
+////////////////////////////////////////////////////////////////////////////////
+bool Database::authenticate (
+  const MsgView& request,
+  Msg& response)
+{
+  return authenticate (request.get ("org").str (),
+                       request.get ("user").str (),
+                       request.get ("key").str (),
+                       response);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool Database::authenticate (
+  const std::string& org,
+  const std::string& user,
+  const std::string& key,
+  Msg& response)
+{
   // Verify existence of <root>/orgs/<org>
   Directory org_dir (_config->get ("root") + "/orgs/" + org);
   if (! verifyExistence  (org_dir, response) ||
@@ -227,6 +247,37 @@ bool Database::add_user (
   // Generate new KEY
   auto key = key_generate ();
 
+  // Load the index before the new directory makes it look stale.
+  Directory root (_config->get ("root"));
+  File lock;
+  taskd_lock_user_index (root, org, lock);
+
+  std::map <std::string, std::string> index;
+  taskd_load_user_index (root, org, index);
+  if (index.find (user) != index.end ())
+    return false;
+
+  if (add_user (org, user, key))
+  {
+    index[user] = key;
+    taskd_save_user_index (root, org, index);
+
+    // User will need this key.
+    std::cout << "New user key: " << key << '\n';
+    return true;
+  }
+
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Creates the user directory and config only.  The caller is responsible for
+// the org's users.index, which allows bulk imports to rewrite it once.
+bool Database::add_user (
+  const std::string& org,
+  const std::string& user,
+  const std::string& key)
+{
   Directory new_user (_config->get ("root"));
   new_user += "orgs";
   new_user += org;
@@ -242,9 +293,6 @@ bool Database::add_user (
     Config conf (conf_file._data);
     conf.set ("user", user);
     conf.save ();
-
-    // User will need this key.
-    std::cout << "New user key: " << key << '\n';
     return true;
   }
 
@@ -268,13 +316,32 @@ bool Database::remove_user (
   const std::string& org,
   const std::string& key)
 {
-  Directory user_dir (_config->get ("root"));
+  Directory root (_config->get ("root"));
+  File lock;
+  taskd_lock_user_index (root, org, lock);
+
+  std::map <std::string, std::string> index;
+  taskd_load_user_index (root, org, index);
+
+  Directory user_dir (root);
   user_dir += "orgs";
   user_dir += org;
   user_dir += "users";
   user_dir += key;
 
-  return user_dir.remove ();
+  if (! user_dir.remove ())
+    return false;
+
+  for (auto i = index.begin (); i != index.end (); )
+  {
+    if (i->second == key)
+      i = index.erase (i);
+    else
+      ++i;
+  }
+
+  taskd_save_user_index (root, org, index);
+  return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
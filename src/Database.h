@@ -30,6 +30,7 @@
 #include <ConfigFile.h>
 #include <FS.h>
 #include <Msg.h>
+#include <MsgView.h>
 #include <Log.h>
 
 class Database
@@ -44,10 +45,12 @@ public:
 
   // These throw on failure.
   bool authenticate (const Msg&, Msg&);
+  bool authenticate (const MsgView&, Msg&);
   bool redirect (const std::string&, Msg&);
 
   bool add_org (const std::string&);
   bool add_user (const std::string&, const std::string&);
+  bool add_user (const std::string&, const std::string&, const std::string&);
   bool remove_org (const std::string&);
   bool remove_user (const std::string&, const std::string&);
   bool suspend (const Directory&);
@@ -56,6 +59,7 @@ public:
   std::string key_generate ();
 
 private:
+  bool authenticate (const std::string&, const std::string&, const std::string&, Msg&);
   bool verifyExistence  (const Path&, Msg&);
   bool verifyReadable   (const Path&, Msg&);
   bool verifyWritable   (const Path&, Msg&);
@@ -0,0 +1,92 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2010 - 2018, Göteborg Bit Factory.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// http://www.opensource.org/licenses/mit-license.php
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cmake.h>
+#include <MsgView.h>
+
+////////////////////////////////////////////////////////////////////////////////
+bool MsgView::parse (const std::string& input)
+{
+  _header.clear ();
+  _payload = StringView ();
+  _owned.clear ();
+
+  auto separator = input.find ("\n\n");
+  if (separator == std::string::npos)
+    throw std::string ("ERROR: Malformed message");
+
+  // Parse header.  Like Msg, every line up to the separator must be a header,
+  // so an empty header block is malformed too.
+  StringView headers (input.data (), separator);
+  size_t start = 0;
+  do
+  {
+    auto newline = headers.find ('\n', start);
+    if (newline == StringView::npos)
+      newline = headers.size ();
+
+    auto line = headers.substr (start, newline - start);
+    auto delimiter = line.find (':');
+    if (delimiter == StringView::npos)
+      throw std::string ("ERROR: Malformed message header '") + line.str () + "'";
+
+    _header.push_back (std::make_pair (line.substr (0, delimiter).trim (),
+                                       line.substr (delimiter + 1).trim ()));
+    start = newline + 1;
+  }
+  while (start <= headers.size ());
+
+  // Parse payload.
+  _payload = StringView (input.data () + separator + 2, input.length () - separator - 2);
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// The last of any repeated headers wins.
+StringView MsgView::get (const StringView& name) const
+{
+  for (auto i = _header.rbegin (); i != _header.rend (); ++i)
+    if (i->first == name)
+      return i->second;
+
+  return StringView ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+StringView MsgView::getPayload () const
+{
+  return _payload;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Replaces the payload with one the MsgView owns, such as an inflated payload.
+void MsgView::setPayload (std::string&& payload)
+{
+  _owned = std::move (payload);
+  _payload = StringView (_owned);
+}
+
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,55 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2010 - 2018, Göteborg Bit Factory.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// http://www.opensource.org/licenses/mit-license.php
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef INCLUDED_MSGVIEW
+#define INCLUDED_MSGVIEW
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <StringView.h>
+
+// A read-only Msg that refers into the buffer it was parsed from, instead of
+// copying headers into a map and the payload into a string.  It parses and
+// answers queries exactly as Msg does: names and values are trimmed, a
+// repeated header takes its last value, and a missing header reads as empty.
+// The parsed buffer must outlive the MsgView.
+class MsgView
+{
+public:
+  bool parse (const std::string&);
+  StringView get (const StringView&) const;
+  StringView getPayload () const;
+  void setPayload (std::string&&);
+
+private:
+  std::vector <std::pair <StringView, StringView>> _header {};
+  StringView _payload                                       {};
+  std::string _owned                                        {};
+};
+
+#endif
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,104 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2010 - 2018, Göteborg Bit Factory.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// http://www.opensource.org/licenses/mit-license.php
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cmake.h>
+#include <RateLimiter.h>
+
+////////////////////////////////////////////////////////////////////////////////
+// A non-positive rate disables limiting.  The burst is at least one token, or
+// nothing would ever be admitted.
+void RateLimiter::configure (double rate, double burst)
+{
+  _rate  = rate;
+  _burst = burst < 1.0 ? 1.0 : burst;
+  _buckets.clear ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Returns the number of seconds until the key has a token to spend, which is
+// zero if it has one now.
+double RateLimiter::wait (const std::string& key, double now)
+{
+  if (! enabled ())
+    return 0.0;
+
+  auto& bucket = refill (key, now);
+  if (bucket.tokens >= 1.0)
+    return 0.0;
+
+  return (1.0 - bucket.tokens) / _rate;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void RateLimiter::take (const std::string& key, double now)
+{
+  if (! enabled ())
+    return;
+
+  auto& bucket = refill (key, now);
+  bucket.tokens -= 1.0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// New keys start with a full bucket.
+RateLimiter::Bucket& RateLimiter::refill (const std::string& key, double now)
+{
+  auto b = _buckets.find (key);
+  if (b == _buckets.end ())
+  {
+    prune (now);
+    return _buckets[key] = Bucket {_burst, now};
+  }
+
+  auto& bucket = b->second;
+  bucket.tokens += (now - bucket.updated) * _rate;
+  if (bucket.tokens > _burst)
+    bucket.tokens = _burst;
+
+  bucket.updated = now;
+  return bucket;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// A bucket that has refilled completely is indistinguishable from a new one,
+// so those are dropped once the map has doubled since the last sweep.
+void RateLimiter::prune (double now)
+{
+  if (_buckets.size () < _prune_at)
+    return;
+
+  for (auto b = _buckets.begin (); b != _buckets.end (); )
+  {
+    if (b->second.tokens + (now - b->second.updated) * _rate >= _burst)
+      b = _buckets.erase (b);
+    else
+      ++b;
+  }
+
+  _prune_at = _buckets.size () * 2 < 1024 ? 1024 : _buckets.size () * 2;
+}
+
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,63 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2010 - 2018, Göteborg Bit Factory.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// http://www.opensource.org/licenses/mit-license.php
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef INCLUDED_RATELIMITER
+#define INCLUDED_RATELIMITER
+
+#include <string>
+#include <unordered_map>
+
+// A set of token buckets, one per key.  Each bucket holds up to 'burst' tokens
+// and refills at 'rate' tokens per second, and each request spends one token.
+// A RateLimiter is not thread-safe; the caller serializes access.
+class RateLimiter
+{
+public:
+  RateLimiter () = default;
+  void configure (double, double);
+  bool enabled () const { return _rate > 0.0; }
+
+  double wait (const std::string&, double);
+  void take (const std::string&, double);
+
+private:
+  struct Bucket
+  {
+    double tokens;
+    double updated;
+  };
+
+  Bucket& refill (const std::string&, double);
+  void prune (double);
+
+  double _rate                                     {0.0};
+  double _burst                                    {0.0};
+  size_t _prune_at                                 {1024};
+  std::unordered_map <std::string, Bucket> _buckets {};
+};
+
+#endif
+////////////////////////////////////////////////////////////////////////////////
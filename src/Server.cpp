@@ -38,15 +38,49 @@
 #include <syslog.h>
 #include <string.h>
 #include <assert.h>
+#include <sys/wait.h>
+#include <poll.h>
+#include <fstream>
+#include <iterator>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <map>
+#include <algorithm>
 #include <Server.h>
 #include <TLSServer.h>
 #include <Timer.h>
 #include <format.h>
+#include <shared.h>
+#include <util.h>
 
-// Indicates that certain signals were caught.
-bool _sighup  = false;
-bool _sigusr1 = false;
-bool _sigusr2 = false;
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// Request lanes.
+static const int small_lane = 0;
+static const int large_lane = 1;
+
+// After this many consecutive small requests, a waiting large request is
+// handled, so that the large lane cannot starve.
+static const int small_run_limit = 8;
+
+// A worker that exits sooner than this many seconds after it started is
+// restarted after a delay that doubles with each such exit, up to the limit.
+static const int worker_min_lifetime  = 10;
+static const int worker_restart_limit = 64;
+
+// Beyond this many lines waiting for the handler thread to log them, lines
+// from the accepting threads are counted and dropped.
+static const size_t deferred_log_limit = 10000;
+
+// Indicates that certain signals were caught.  The handler may run on any
+// thread, and the flags are read by others, so they are lock-free atomics.
+std::atomic <bool> _sighup  {false};
+std::atomic <bool> _sigusr1 {false};
+std::atomic <bool> _sigusr2 {false};
+std::atomic <bool> _sigterm {false};
 
 ////////////////////////////////////////////////////////////////////////////////
 static void signal_handler (int s)
@@ -56,9 +90,23 @@ static void signal_handler (int s)
   case SIGHUP:  _sighup  = true; break;  // Graceful stop
   case SIGUSR1: _sigusr1 = true; break;  // Config reload
   case SIGUSR2: _sigusr2 = true; break;
+  case SIGTERM: _sigterm = true; break;  // Supervisor only
   }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// A received request waiting for the handler, and the connection on which the
+// response is sent.
+struct Server::Request
+{
+  TLSTransaction tx       {};
+  std::string input       {""};
+  std::string address     {""};
+  int port                {0};
+  int lane                {small_lane};
+  Timer timer             {};
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 Server::Server ()
 {
@@ -104,6 +152,13 @@ void Server::setPoolSize (int size)
   _pool_size = size;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+void Server::setProcesses (int count)
+{
+  if (_log) _log->write (format ("Worker processes {1}", count));
+  _processes = count;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void Server::setDaemon ()
 {
@@ -127,6 +182,15 @@ void Server::setLimit (int max)
   _limit = max;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Requests of at least this many bytes, by their advertised length, are queued
+// in the large lane.
+void Server::setLaneThreshold (int bytes)
+{
+  if (_log) _log->write (format ("Large request lane from {1} bytes", bytes));
+  _lane_threshold = bytes;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void Server::setCAFile (const std::string& file)
 {
@@ -191,6 +255,10 @@ void Server::beginServer ()
 {
   if (_log) _log->write ("Server starting");
 
+  // Under systemd socket activation, the listening socket is inherited.  This
+  // is checked before daemonizing changes the PID.
+  int listener = activationSocket ();
+
   if (_daemon)
   {
     daemonize ();  // Only the child returns.
@@ -204,7 +272,30 @@ void Server::beginServer ()
   if (signal (SIGUSR2, signal_handler) == SIG_ERR)
     throw std::string ("Failed to register handler for SIGUSR2... Exiting.");
 
+  // A predecessor may be handing over its listening socket.  It serves until
+  // this process acknowledges, which happens only once this process is ready
+  // to serve.  If this process fails first, the channel closes when it exits.
+  int channel = -1;
+  auto handoff = getenv ("TASKD_HANDOFF_FD");
+  if (handoff)
+  {
+    channel = strtol (handoff, NULL, 10);
+    unsetenv ("TASKD_HANDOFF_FD");
+    listener = takeOver (channel);
+  }
+
+  // With several processes, this one only supervises, and the workers return
+  // here to serve.  Workers cannot share one acknowledgement.
+  if (_processes > 1)
+  {
+    if (channel != -1)
+      throw std::string ("A listening socket cannot be taken over with several processes.");
+
+    superviseWorkers ();
+  }
+
   TLSServer server;
+  server.reusePort (_processes > 1);
   if (_config)
   {
     server.debug (_config->getInteger ("debug.tls"));
@@ -224,6 +315,8 @@ void Server::beginServer ()
     else if (_log)
       _log->write (format ("Invalid 'trust' setting value of '{1}'", trust));
 
+    server.verifyCache (_config->get ("verify.cache") == "" ? 300 : _config->getInteger ("verify.cache"));
+
     int dh_bits = _config->getInteger ("dh_bits");
     if (dh_bits < 0)
     {
@@ -233,54 +326,167 @@ void Server::beginServer ()
 
     server.dh_bits (dh_bits);
     if (_log) _log->write (format ("Using dh_bits: {1}", dh_bits));
+
+    // Generated DH parameters are cached in the data directory.
+    server.dh_cache (_config->get ("root"),
+                     _config->get ("dh_lifetime") == "" ? 30 : _config->getInteger ("dh_lifetime"));
   }
 
-  server.init (_ca_file,        // CA
-               _crl_file,       // CRL
-               _cert_file,      // Cert
-               _key_file);      // Key
-  server.queue (_queue_size);
-  server.bind (_host, _port, _family);
-  server.listen ();
+  try
+  {
+    server.init (_ca_file,        // CA
+                 _crl_file,       // CRL
+                 _cert_file,      // Cert
+                 _key_file);      // Key
+    if (listener != -1)
+    {
+      server.adopt (listener);
+      if (_log) _log->write ("Using inherited listening socket");
+    }
+    else
+    {
+      server.queue (_queue_size);
+      server.bind (_host, _port, _family);
+      server.listen ();
+    }
+  }
+
+  catch (...)
+  {
+    if (channel != -1)
+      close (channel);
+
+    throw;
+  }
+
+  // Without the socket, the predecessor has nothing to hand over, and serves on.
+  if (channel != -1)
+  {
+    if (listener != -1)
+      acknowledgeHandOff (channel);
+    else
+      close (channel);
+  }
 
   if (_log) _log->write ("Server ready");
 
+  // A pool of threads accepts connections, performs the TLS handshakes and
+  // reads requests, all of which may proceed in parallel.  The handler is not
+  // thread-safe, so requests are queued and handled on this thread.
+  //
+  // A poll costs microseconds to handle, and an initial sync of thousands of
+  // tasks may cost seconds, so small and large requests are queued in separate
+  // lanes.  Small requests are handled first, so that polls do not queue
+  // behind large requests, and large requests get every small_run_limit-th
+  // turn while both wait.  There is still only the one handler, though, so a
+  // poll that arrives while a large request is being handled waits for it.
+  // Several processes ('processes') give polls other handlers to go to.
+  if (_pool_size < 1)
+    _pool_size = 1;
+
+  _accepting = _pool_size;
+  std::vector <std::thread> threads;
+  for (int i = 0; i < _pool_size; ++i)
+    threads.push_back (std::thread (&Server::acceptRequests, this, std::ref (server)));
+
+  bool handed_off = false;
   _request_count = 0;
   while (1)
   {
-    try
+    writeDeferredLog ();
+
+    // SIGUSR2 hands the listening socket to a new process, and SIGHUP stops.
+    // Either way, the threads stop accepting, and requests already accepted
+    // are handled before this returns.  A successor may take minutes to get
+    // ready, and this process serves until it is.
+    if (_sigusr2 && ! _draining)
     {
-      TLSTransaction tx;
-      tx.trust (server.trust ());
-      server.accept (tx);
+      _sigusr2 = false;
+      if (_processes > 1)
+      {
+        if (_log) _log->write ("SIGUSR2 ignored by a worker process");
+      }
+      else if (_handoff_channel != -1)
+      {
+        if (_log) _log->write ("SIGUSR2 ignored, a successor is starting");
+      }
+      else
+        handOff (server);
+    }
 
-      if (_sighup)
-        throw "SIGHUP shutdown.";
+    if (_handoff_channel != -1 &&
+        ! _draining &&
+        handOffStatus () > 0)
+    {
+      handed_off = true;
+      _draining = true;
+    }
 
-      // Get client address and port, for logging.
-      if (_log_clients)
-        tx.getClient (_client_address, _client_port);
+    if (_sighup && ! _draining)
+    {
+      _sighup = false;
+      _draining = true;
+      if (_log) _log->write ("SIGHUP, finishing pending requests");
+    }
 
-      // Metrics.
-      Timer timer;
-      timer.start ();
+    std::unique_ptr <Request> request;
+    {
+      std::unique_lock <std::mutex> lock (_pending_mutex);
+      _pending_ready.wait_for (lock, std::chrono::seconds (1), [this] { return ! _pending[small_lane].empty () ||
+                                                                               ! _pending[large_lane].empty () ||
+                                                                               ! _deferred_log.empty ()        ||
+                                                                               (_draining && ! _accepting); });
+
+      if (_pending[small_lane].empty () &&
+          _pending[large_lane].empty ())
+      {
+        if (_draining && ! _accepting)
+          break;
+
+        continue;
+      }
+
+      auto lane = small_lane;
+      if (! _pending[large_lane].empty () &&
+          (_pending[small_lane].empty () || _small_run >= small_run_limit))
+        lane = large_lane;
 
-      std::string input;
-      tx.recv (input);
+      _small_run = lane == small_lane ? _small_run + 1 : 0;
+
+      request = std::move (_pending[lane].front ());
+      _pending[lane].pop_front ();
+    }
+
+    try
+    {
+      _client_address = request->address;
+      _client_port    = request->port;
 
       // Handle the request.
       ++_request_count;
 
+      Timer service;
+      service.start ();
+
       // Call the derived class handler.
       std::string output;
-      handler (input, output);
+      handler (request->input, output);
       if (output.length ())
-        tx.send (output);
+        request->tx.send (output);
+
+      // A moving average of the handler time in each lane, for admission
+      // decisions.
+      service.stop ();
+      {
+        std::lock_guard <std::mutex> lock (_pending_mutex);
+        auto& average = _service_time[request->lane];
+        average = 0.9 * average + 0.1 * (service.total_us () / 1e6);
+      }
 
       if (_log)
       {
-        timer.stop ();
-        _log->write (format ("[{1}] Serviced in {2}s", _request_count, (timer.total_us () / 1e6)));
+        request->timer.stop ();
+        _log->write (format ("[{1}] Serviced in {2}s", _request_count, (request->timer.total_us () / 1e6)));
       }
     }
 
@@ -288,6 +494,452 @@ void Server::beginServer ()
     catch (char* e)        { if (_log) _log->write (std::string ("Error: ") + e); }
     catch (...)            { if (_log) _log->write ("Error: Unknown exception"); }
   }
+
+  // Every thread has stopped accepting, and 'server' must outlive them.
+  for (auto& thread : threads)
+    thread.join ();
+
+  // A successor that is still starting sees the channel close, and stops.
+  if (_handoff_channel != -1)
+  {
+    close (_handoff_channel);
+    _handoff_channel = -1;
+  }
+
+  writeDeferredLog ();
+  if (_log) _log->write (handed_off ? "Handed over to successor, exiting" : "Server stopped");
+
+  // The successor has written its own PID file.
+  if (_daemon && ! handed_off)
+    removePidFile ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Implements the systemd socket activation protocol, see sd_listen_fds(3).
+// Returns the first passed socket, or -1 if there is none.  The variables are
+// removed, so that they are not inherited by any successor.
+int Server::activationSocket ()
+{
+  auto pid   = getenv ("LISTEN_PID");
+  auto count = getenv ("LISTEN_FDS");
+
+  int listener = -1;
+  if (pid && count &&
+      strtol (pid, NULL, 10) == getpid () &&
+      strtol (count, NULL, 10) >= 1)
+  {
+    // SD_LISTEN_FDS_START.
+    listener = 3;
+
+    if (_log)
+    {
+      _log->write ("Socket activated");
+      if (strtol (count, NULL, 10) > 1)
+        _log->write (format ("Ignoring {1} additional sockets", strtol (count, NULL, 10) - 1));
+    }
+  }
+
+  unsetenv ("LISTEN_PID");
+  unsetenv ("LISTEN_FDS");
+  unsetenv ("LISTEN_FDNAMES");
+  return listener;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Derived classes may refuse a request before it is queued, by composing the
+// output and returning false.  They are told how many requests are already
+// waiting in its lane, and roughly how many seconds those will take to handle.
+// This is called concurrently from the accepting threads.
+bool Server::admit (const std::string&, std::string&, int, double)
+{
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Derived classes may refuse a client by its address, before its request is
+// read, by composing the output and returning false.  This is called
+// concurrently from the accepting threads.
+bool Server::admitAddress (const std::string&, std::string&)
+{
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// The Log is not thread-safe, so the accepting threads queue their lines with
+// this, and the handler thread writes them.
+void Server::deferLog (const std::string& line)
+{
+  if (! _log)
+    return;
+
+  {
+    std::lock_guard <std::mutex> lock (_pending_mutex);
+    if (_deferred_log.size () < deferred_log_limit)
+      _deferred_log.push_back (line);
+    else
+      ++_deferred_dropped;
+  }
+
+  _pending_ready.notify_one ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Runs on the handler thread only.
+void Server::writeDeferredLog ()
+{
+  std::vector <std::string> lines;
+  long dropped;
+  {
+    std::lock_guard <std::mutex> lock (_pending_mutex);
+    lines.swap (_deferred_log);
+    dropped = _deferred_dropped;
+    _deferred_dropped = 0;
+  }
+
+  if (_log)
+  {
+    for (auto& line : lines)
+      _log->write (line);
+
+    if (dropped)
+      _log->write (format ("{1} log lines dropped", dropped));
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Runs on each thread of the pool, until the server drains.
+void Server::acceptRequests (TLSServer& server)
+{
+  while (! _draining)
+  {
+    try
+    {
+      // Look up every second, to notice draining.
+      if (! server.ready (1000))
+        continue;
+
+      std::unique_ptr <Request> request (new Request);
+      auto& tx = request->tx;
+      tx.trust (server.trust ());
+      if (! server.accept (tx))
+        continue;
+
+      // The client address is needed for admission, and kept for logging.
+      std::string address;
+      int port;
+      tx.getClient (address, port);
+      if (_log_clients)
+      {
+        request->address = address;
+        request->port    = port;
+      }
+
+      // Metrics.
+      request->timer.start ();
+
+      // The advertised length chooses the lane.
+      auto expected = tx.recvHeader ();
+      if (_lane_threshold > 0 &&
+          expected >= (unsigned long) _lane_threshold)
+        request->lane = large_lane;
+
+      // A refused client's request is not read.  Closing with it unread may
+      // reset the connection before the client reads the response.
+      std::string output;
+      if (! admitAddress (address, output))
+      {
+        if (output.length ())
+          tx.send (output);
+
+        continue;
+      }
+
+      tx.recvBody (request->input, expected);
+
+      // A small request waits for the small lane, plus at most one large
+      // request in progress.
+      int pending;
+      double wait;
+      {
+        std::lock_guard <std::mutex> lock (_pending_mutex);
+        pending = (int) _pending[request->lane].size ();
+        wait = (pending + 1) * _service_time[request->lane];
+        if (request->lane == small_lane)
+          wait += _service_time[large_lane];
+      }
+
+      // A refused request is answered from this thread, without queueing.
+      if (! admit (request->input, output, pending, wait))
+      {
+        if (output.length ())
+          tx.send (output);
+
+        continue;
+      }
+
+      {
+        std::lock_guard <std::mutex> lock (_pending_mutex);
+        auto lane = request->lane;
+        _pending[lane].push_back (std::move (request));
+      }
+
+      _pending_ready.notify_one ();
+    }
+
+    catch (std::string& e) { deferLog (std::string ("Error: ") + e); }
+    catch (char* e)        { deferLog (std::string ("Error: ") + e); }
+    catch (...)            { deferLog ("Error: Unknown exception"); }
+  }
+
+  {
+    std::lock_guard <std::mutex> lock (_pending_mutex);
+    --_accepting;
+  }
+
+  _pending_ready.notify_one ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Starts a successor, running the binary of the same name with the same
+// arguments, and passes it the listening socket over a Unix domain socket whose
+// descriptor is in $TASKD_HANDOFF_FD.  Returns true if the successor started,
+// and handOffStatus reports when it holds the socket, from which point both
+// processes accept on it, until this one drains and exits.  Clients are never
+// refused, and a new binary or certificate is picked up without downtime.
+bool Server::handOff (TLSServer& server)
+{
+  std::ifstream in ("/proc/self/cmdline");
+  std::string cmdline ((std::istreambuf_iterator <char> (in)),
+                       std::istreambuf_iterator <char> ());
+
+  std::vector <std::string> args;
+  for (auto& arg : split (cmdline, '\0'))
+    if (arg != "")
+      args.push_back (arg);
+
+  if (args.empty ())
+  {
+    if (_log) _log->write ("SIGUSR2 ignored, the command line is unavailable");
+    return false;
+  }
+
+  std::vector <char*> argv;
+  for (auto& arg : args)
+    argv.push_back (const_cast <char*> (arg.c_str ()));
+  argv.push_back (nullptr);
+
+  int channel[2];
+  if (socketpair (AF_UNIX, SOCK_STREAM, 0, channel) == -1)
+  {
+    if (_log) _log->write (format ("SIGUSR2 ignored. {1}", strerror (errno)));
+    return false;
+  }
+
+  if (_log) _log->write (format ("SIGUSR2, starting successor '{1}'", args[0]));
+
+  // The environment is prepared before forking, because only async-signal-safe
+  // calls are allowed in the child of a threaded process.
+  setenv ("TASKD_HANDOFF_FD", format ("{1}", channel[1]).c_str (), 1);
+  pid_t pid = fork ();
+  if (pid == 0)
+  {
+    close (channel[0]);
+    execvp (argv[0], argv.data ());
+    _exit (127);
+  }
+
+  unsetenv ("TASKD_HANDOFF_FD");
+  close (channel[1]);
+
+  _handoff_channel = channel[0];
+  _handoff_pid     = pid;
+  if (pid > 0 &&
+      sendDescriptor (_handoff_channel, server.descriptor ()))
+    return true;
+
+  handOffDone (false, 0);
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Returns 1 once the successor is serving, -1 if it failed, and 0 while it is
+// still starting.  The successor acknowledges with its PID once it is ready to
+// serve, or the channel closes if it fails first.
+int Server::handOffStatus ()
+{
+  struct pollfd ready {_handoff_channel, POLLIN, 0};
+  if (poll (&ready, 1, 0) <= 0)
+    return 0;
+
+  pid_t successor = 0;
+  bool handed_off = read (_handoff_channel, &successor, sizeof (successor)) == sizeof (successor);
+  handOffDone (handed_off, successor);
+  return handed_off ? 1 : -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// With --daemon, the forked child is only the intermediate that daemonize ()
+// forks and exits, so the successor reports its own PID.
+void Server::handOffDone (bool handed_off, pid_t successor)
+{
+  close (_handoff_channel);
+  _handoff_channel = -1;
+
+  if (_handoff_pid > 0)
+  {
+    // A child that is itself the successor but did not take over is stopped.
+    // The intermediate exits at once, and the successor outlives this process.
+    if (! _daemon && ! handed_off)
+      kill (_handoff_pid, SIGTERM);
+
+    if (_daemon || ! handed_off)
+      waitpid (_handoff_pid, NULL, 0);
+  }
+
+  _handoff_pid = 0;
+
+  // A failed successor may have replaced the PID file before it exited.
+  if (_daemon && ! handed_off)
+    writePidFile ();
+
+  if (_log) _log->write (handed_off ? format ("Successor {1} is accepting", successor)
+                                    : std::string ("Successor failed, continuing"));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// The successor's side of handOff.  Returns the listening socket, or -1.  The
+// channel stays open for acknowledgeHandOff.
+int Server::takeOver (int channel)
+{
+  int listener = receiveDescriptor (channel);
+
+  if (_log) _log->write (listener != -1 ? "Received listening socket from predecessor"
+                                        : "No listening socket from predecessor");
+  return listener;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Tells the predecessor that this process is serving, and may stop.  This runs
+// after daemonize (), so the PID sent is the final one.  If the predecessor
+// does not hear it, it keeps serving too, so this process stops.
+void Server::acknowledgeHandOff (int channel)
+{
+  // A predecessor that stopped meanwhile has closed the channel, which must not
+  // raise SIGPIPE.
+  pid_t self = getpid ();
+  bool sent = send (channel, &self, sizeof (self), MSG_NOSIGNAL) == sizeof (self);
+  close (channel);
+
+  if (! sent)
+    throw std::string ("Could not acknowledge the predecessor.");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Forks the worker processes, and returns only in a worker.  Each worker binds
+// its own listening socket to the shared port, with SO_REUSEPORT, and the
+// kernel balances connections among them.  A worker that dies is replaced,
+// with a growing delay if workers keep dying soon after they start, such as
+// when the port is taken.  SIGUSR1 is forwarded to the workers, and SIGHUP and
+// SIGTERM are forwarded, after which the supervisor exits once the workers
+// have.  Only the supervisor writes and removes the PID file.
+void Server::superviseWorkers ()
+{
+  if (signal (SIGTERM, signal_handler) == SIG_ERR)
+    throw std::string ("Failed to register handler for SIGTERM... Exiting.");
+
+  std::map <pid_t, time_t> workers;
+  bool stopping = false;
+  int fast_exits = 0;
+  time_t restart_at = 0;
+
+  while (1)
+  {
+    while (! stopping &&
+           (int) workers.size () < _processes &&
+           time (NULL) >= restart_at)
+    {
+      pid_t pid = fork ();
+      if (pid < 0)
+        throw format ("Failed to fork a worker. {1}", strerror (errno));
+
+      if (pid == 0)
+      {
+        signal (SIGTERM, SIG_DFL);
+        _daemon = false;
+        return;
+      }
+
+      if (_log) _log->write (format ("Started worker {1}", pid));
+      workers[pid] = time (NULL);
+    }
+
+    if (_sigusr2)
+    {
+      _sigusr2 = false;
+      if (_log) _log->write ("SIGUSR2 ignored, not supported with several processes");
+    }
+
+    int forward = 0;
+    if (_sigusr1)
+    {
+      _sigusr1 = false;
+      forward = SIGUSR1;
+    }
+    else if (_sighup || _sigterm)
+    {
+      forward = _sigterm ? SIGTERM : SIGHUP;
+      _sighup = _sigterm = false;
+      stopping = true;
+    }
+
+    if (forward)
+      for (auto& worker : workers)
+        kill (worker.first, forward);
+
+    int status;
+    pid_t pid;
+    while ((pid = waitpid (-1, &status, WNOHANG)) > 0)
+    {
+      auto worker = workers.find (pid);
+      if (worker == workers.end ())
+        continue;
+
+      auto lifetime = time (NULL) - worker->second;
+      workers.erase (worker);
+      if (_log)
+      {
+        if (WIFSIGNALED (status))
+          _log->write (format ("Worker {1} killed by signal {2}", pid, WTERMSIG (status)));
+        else
+          _log->write (format ("Worker {1} exited with status {2}", pid, WEXITSTATUS (status)));
+      }
+
+      if (stopping)
+        continue;
+
+      if (lifetime >= worker_min_lifetime)
+      {
+        fast_exits = 0;
+        continue;
+      }
+
+      auto delay = std::min (1 << std::min (++fast_exits, 6), worker_restart_limit);
+      restart_at = time (NULL) + delay;
+      if (_log) _log->write (format ("Worker {1} exited after {2}s, restarting in {3}s", pid, lifetime, delay));
+    }
+
+    if (stopping &&
+        workers.empty ())
+    {
+      if (_log) _log->write ("Server stopped");
+      if (_daemon)
+        removePidFile ();
+
+      exit (EXIT_SUCCESS);
+    }
+
+    sleep (1);
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -28,9 +28,17 @@
 
 #include <sys/types.h>
 #include <string>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
 #include <ConfigFile.h>
 #include <Log.h>
 
+class TLSServer;
+
 class Server
 {
 public:
@@ -40,6 +48,7 @@ public:
   void setPort (const std::string&);
   void setFamily (const std::string&);
   void setPoolSize (int);
+  void setProcesses (int);
   void setQueueSize (int);
   void setDaemon ();
   void setBlocking ();
@@ -48,6 +57,7 @@ public:
   void setLog (Log*);
   void setConfig (Config*);
   void setLimit (int);
+  void setLaneThreshold (int);
   void setCAFile (const std::string&);
   void setCertFile (const std::string&);
   void setKeyFile (const std::string&);
@@ -58,11 +68,21 @@ public:
   void beginServer ();
 
   virtual void handler (const std::string&, std::string&) = 0;
+  virtual bool admit (const std::string&, std::string&, int, double);
+  virtual bool admitAddress (const std::string&, std::string&);
 
 protected:
   void daemonize ();
   void writePidFile ();
   void removePidFile ();
+  void superviseWorkers ();
+  int activationSocket ();
+  bool handOff (TLSServer&);
+  int handOffStatus ();
+  void handOffDone (bool, pid_t);
+  int takeOver (int);
+  void acknowledgeHandOff (int);
+  void deferLog (const std::string&);
 
   Log* _log                    {nullptr};
   Config* _config              {nullptr};
@@ -71,10 +91,15 @@ protected:
   int _client_port             {0};
 
 private:
+  struct Request;
+  void acceptRequests (TLSServer&);
+  void writeDeferredLog ();
+
   std::string _host            {"::"};
   std::string _port            {"53589"};
   std::string _family          {"IPv6"};
   int _pool_size               {4};
+  int _processes               {1};
   int _queue_size              {10};
   bool _daemon                 {false};
   std::string _pid_file        {""};
@@ -84,6 +109,20 @@ private:
   std::string _cert_file       {""};
   std::string _key_file        {""};
   std::string _crl_file        {""};
+
+  // Received requests wait in one of two lanes, small and large.
+  int _lane_threshold                                {65536};
+  std::deque <std::unique_ptr <Request>> _pending[2];
+  std::mutex _pending_mutex                          {};
+  std::condition_variable _pending_ready             {};
+  double _service_time[2]                            {0.0, 0.0};
+  int _small_run                                     {0};
+  int _accepting                                     {0};
+  std::atomic <bool> _draining                       {false};
+  int _handoff_channel                               {-1};
+  pid_t _handoff_pid                                 {0};
+  std::vector <std::string> _deferred_log            {};
+  long _deferred_dropped                             {0};
 };
 
 #endif
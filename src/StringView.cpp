@@ -0,0 +1,78 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2010 - 2018, Göteborg Bit Factory.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// http://www.opensource.org/licenses/mit-license.php
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cmake.h>
+#include <algorithm>
+#include <StringView.h>
+
+////////////////////////////////////////////////////////////////////////////////
+size_t StringView::find (char c, size_t pos /* = 0 */) const
+{
+  if (pos >= _size)
+    return npos;
+
+  auto found = (const char*) memchr (_data + pos, c, _size - pos);
+  return found ? (size_t) (found - _data) : npos;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+size_t StringView::find (const StringView& needle, size_t pos /* = 0 */) const
+{
+  if (pos > _size ||
+      needle._size > _size - pos)
+    return npos;
+
+  auto found = std::search (_data + pos, _data + _size,
+                            needle._data, needle._data + needle._size);
+  return found == _data + _size && needle._size ? npos : (size_t) (found - _data);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+StringView StringView::substr (size_t pos, size_t count /* = npos */) const
+{
+  if (pos > _size)
+    pos = _size;
+
+  return StringView (_data + pos, std::min (count, _size - pos));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Removes what trim () in libshared removes by default, which is spaces only,
+// so that MsgView reads a header exactly as Msg does.
+StringView StringView::trim () const
+{
+  size_t left = 0;
+  while (left < _size && _data[left] == ' ')
+    ++left;
+
+  size_t right = _size;
+  while (right > left && _data[right - 1] == ' ')
+    --right;
+
+  return StringView (_data + left, right - left);
+}
+
+////////////////////////////////////////////////////////////////////////////////
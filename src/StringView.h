@@ -0,0 +1,76 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2010 - 2018, Göteborg Bit Factory.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// http://www.opensource.org/licenses/mit-license.php
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef INCLUDED_STRINGVIEW
+#define INCLUDED_STRINGVIEW
+
+#include <string>
+#include <cstring>
+
+// A non-owning reference to a run of characters, such as a line in a mapped
+// file, or a header in a request buffer.  The referenced memory must outlive
+// the view.
+class StringView
+{
+public:
+  StringView () = default;
+  StringView (const char* data, size_t size) : _data (data), _size (size) {}
+  StringView (const std::string& s) : _data (s.data ()), _size (s.length ()) {}
+  StringView (const char* s) : _data (s), _size (strlen (s)) {}
+
+  const char* data () const   { return _data; }
+  size_t size () const        { return _size; }
+  size_t length () const      { return _size; }
+  bool empty () const         { return _size == 0; }
+  const char* begin () const  { return _data; }
+  const char* end () const    { return _data + _size; }
+
+  // Like std::string, the character at size () reads as '\0'.
+  char operator[] (size_t i) const { return i < _size ? _data[i] : '\0'; }
+
+  bool operator== (const StringView& other) const
+  {
+    return _size == other._size &&
+           (_size == 0 || memcmp (_data, other._data, _size) == 0);
+  }
+
+  bool operator!= (const StringView& other) const { return ! (*this == other); }
+
+  size_t find (char, size_t pos = 0) const;
+  size_t find (const StringView&, size_t pos = 0) const;
+  StringView substr (size_t pos, size_t count = std::string::npos) const;
+  StringView trim () const;
+  std::string str () const    { return std::string (_data, _size); }
+
+  static const size_t npos = std::string::npos;
+
+private:
+  const char* _data {""};
+  size_t _size      {0};
+};
+
+#endif
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,186 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2006 - 2018, Paul Beckingham, Federico Hernandez.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// http://www.opensource.org/licenses/mit-license.php
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cmake.h>
+#include <atomic>
+#include <mutex>
+#include <cstring>
+#include <stdint.h>
+#include <Symbol.h>
+
+// Open addressing, insert-only, and never more than half full, so that a probe
+// always ends.  Lookups read the slots without a lock, and insertions are
+// serialized.  A slot is published only once its string is constructed.
+static const size_t slots = 4096;
+static const size_t limit = slots / 2;
+
+static std::atomic <const std::string*> table[slots];
+static std::mutex insert_mutex;
+static size_t interned = 0;
+
+static const std::string empty;
+
+////////////////////////////////////////////////////////////////////////////////
+// FNV-1a.
+static uint64_t hash (const char* data, size_t length)
+{
+  uint64_t h = 14695981039346656037ULL;
+  for (size_t i = 0; i < length; ++i)
+  {
+    h ^= (unsigned char) data[i];
+    h *= 1099511628211ULL;
+  }
+
+  return h;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Returns the interned name, or null, with slot set to the empty slot where it
+// would be inserted.
+static const std::string* find (const char* data, size_t length, size_t& slot)
+{
+  for (slot = hash (data, length) & (slots - 1); ; slot = (slot + 1) & (slots - 1))
+  {
+    auto s = table[slot].load (std::memory_order_acquire);
+    if (! s)
+      return nullptr;
+
+    if (s->length () == length &&
+        ! memcmp (s->data (), data, length))
+      return s;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Returns the interned name, inserting it if there is room, or null.
+static const std::string* intern (const char* data, size_t length)
+{
+  if (length >= 11 &&
+      ! memcmp (data, "annotation_", 11))
+    return nullptr;
+
+  size_t slot;
+  auto s = find (data, length, slot);
+  if (s)
+    return s;
+
+  std::lock_guard <std::mutex> lock (insert_mutex);
+  s = find (data, length, slot);
+  if (s || interned >= limit)
+    return s;
+
+  s = new std::string (data, length);
+  table[slot].store (s, std::memory_order_release);
+  ++interned;
+  return s;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Symbol::Symbol ()
+: _s (&empty)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Symbol::Symbol (const std::string& name)
+{
+  assign (name.data (), name.length ());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Symbol::Symbol (const char* name)
+{
+  assign (name, strlen (name));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Symbol::Symbol (const Symbol& other)
+: _s (other._owned ? new std::string (*other._s) : other._s)
+, _owned (other._owned)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Symbol::Symbol (Symbol&& other)
+: _s (other._s)
+, _owned (other._owned)
+{
+  other._s     = &empty;
+  other._owned = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Symbol& Symbol::operator= (const Symbol& other)
+{
+  if (this != &other)
+  {
+    Symbol copy (other);
+    *this = std::move (copy);
+  }
+
+  return *this;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Symbol& Symbol::operator= (Symbol&& other)
+{
+  if (this != &other)
+  {
+    if (_owned)
+      delete _s;
+
+    _s           = other._s;
+    _owned       = other._owned;
+    other._s     = &empty;
+    other._owned = false;
+  }
+
+  return *this;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Symbol::~Symbol ()
+{
+  if (_owned)
+    delete _s;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void Symbol::assign (const char* name, size_t length)
+{
+  _s = intern (name, length);
+  _owned = _s == nullptr;
+  if (_owned)
+    _s = new std::string (name, length);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::ostream& operator<< (std::ostream& out, const Symbol& symbol)
+{
+  return out << symbol.str ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,78 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2006 - 2018, Paul Beckingham, Federico Hernandez.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// http://www.opensource.org/licenses/mit-license.php
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef INCLUDED_SYMBOL
+#define INCLUDED_SYMBOL
+
+#include <string>
+#include <ostream>
+
+// An attribute name, interned in a process-wide table, so that every task
+// holding 'status' or 'modified' points at one shared string, and equal names
+// compare by pointer.  The table is bounded, and annotation names, which are
+// nearly all distinct, are not interned; such a Symbol owns its string.
+// Interned strings live until the process exits.
+class Symbol
+{
+public:
+  Symbol ();
+  Symbol (const std::string&);
+  Symbol (const char*);
+  Symbol (const Symbol&);
+  Symbol (Symbol&&);
+  Symbol& operator= (const Symbol&);
+  Symbol& operator= (Symbol&&);
+  ~Symbol ();
+
+  const std::string& str () const         { return *_s; }
+  operator const std::string& () const    { return *_s; }
+  bool interned () const                  { return ! _owned; }
+
+  bool operator== (const Symbol& other) const
+  {
+    return _s == other._s ||
+           ((_owned || other._owned) && *_s == *other._s);
+  }
+
+  bool operator!= (const Symbol& other) const { return ! (*this == other); }
+
+  // Ordered by content, so that a std::map of symbols iterates alphabetically.
+  bool operator< (const Symbol& other) const
+  {
+    return _s != other._s && *_s < *other._s;
+  }
+
+private:
+  void assign (const char*, size_t);
+
+  const std::string* _s     {nullptr};
+  bool               _owned {false};
+};
+
+std::ostream& operator<< (std::ostream&, const Symbol&);
+
+#endif
+////////////////////////////////////////////////////////////////////////////////
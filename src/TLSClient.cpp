@@ -560,9 +560,12 @@ void TLSClient::recv (std::string& data)
     else if (received < 0)
       throw std::string (gnutls_strerror (received)); // All
 
-    buffer [received] = '\0';
-    data += buffer;
-    total += received;
+    // The payload may be binary, so it is appended by length.
+    if (received > 0)
+    {
+      data.append (buffer, received);
+      total += received;
+    }
 
     // Stop at defined limit.
     if (_limit && total > _limit)
@@ -44,17 +44,81 @@
 #include <sys/errno.h>
 #endif
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <netdb.h>
 #include <gnutls/x509.h>
+#include <fstream>
+#include <iterator>
+#include <thread>
 #include <format.h>
+#include <util.h>
 
 #define DH_BITS 2048
 #define MAX_BUF 16384
 
-#if GNUTLS_VERSION_NUMBER < 0x030406
 #if GNUTLS_VERSION_NUMBER >= 0x020a00
 static int verify_certificate_callback (gnutls_session_t);
 #endif
+
+#if GNUTLS_VERSION_NUMBER < 0x030506
+////////////////////////////////////////////////////////////////////////////////
+// Reads DH parameters written by save_dh_params.
+static bool load_dh_params (gnutls_dh_params_t params, const std::string& file)
+{
+  std::ifstream in (file);
+  std::string contents ((std::istreambuf_iterator <char> (in)),
+                        std::istreambuf_iterator <char> ());
+  if (contents == "")
+    return false;
+
+  gnutls_datum_t datum {(unsigned char*) contents.data (), (unsigned int) contents.size ()};
+  return gnutls_dh_params_import_pkcs3 (params, &datum, GNUTLS_X509_FMT_PEM) >= 0; // All
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Writes DH parameters as PKCS#3 PEM, by way of a temporary file, so that a
+// reader never sees a partial file.  Worker processes may save at the same
+// time, so each writes its own uniquely named file, and the last rename wins.
+static bool save_dh_params (gnutls_dh_params_t params, const std::string& file)
+{
+  unsigned char buffer[16384];
+  size_t size = sizeof (buffer);
+  if (gnutls_dh_params_export_pkcs3 (params, GNUTLS_X509_FMT_PEM, buffer, &size) < 0) // All
+    return false;
+
+  auto temp = file + ".XXXXXX";
+  int fd = ::mkstemp (&temp[0]);
+  if (fd == -1)
+    return false;
+
+  bool written = writeAll (fd, std::string ((const char*) buffer, size));
+  ::close (fd);
+
+  if (! written ||
+      ::rename (temp.c_str (), file.c_str ()) == -1)
+  {
+    ::unlink (temp.c_str ());
+    return false;
+  }
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Runs on a background thread, so that the next start finds fresh parameters.
+static void regenerate_dh_params (unsigned int bits, const std::string& file)
+{
+  gnutls_dh_params_t params;
+  if (gnutls_dh_params_init (&params) < 0) // All
+    return;
+
+  if (gnutls_dh_params_generate2 (params, bits) >= 0) // All
+    save_dh_params (params, file);
+
+  gnutls_dh_params_deinit (params); // All
+}
 #endif
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -64,7 +128,6 @@ static void gnutls_log_function (int level, const char* message)
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-#if GNUTLS_VERSION_NUMBER < 0x030406
 #if GNUTLS_VERSION_NUMBER >= 0x020a00
 static int verify_certificate_callback (gnutls_session_t session)
 {
@@ -72,7 +135,32 @@ static int verify_certificate_callback (gnutls_session_t session)
   return tx->verify_certificate ();
 }
 #endif
-#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// SHA-256 of the client certificate, as presented, and its expiry time.
+static std::string peer_fingerprint (gnutls_session_t session, time_t& expires)
+{
+  unsigned int size = 0;
+  const gnutls_datum_t* peers = gnutls_certificate_get_peers (session, &size); // All
+  if (peers == NULL || size == 0)
+    return "";
+
+  unsigned char digest[32];
+  size_t length = sizeof (digest);
+  if (gnutls_fingerprint (GNUTLS_DIG_SHA256, &peers[0], digest, &length) < 0) // All
+    return "";
+
+  gnutls_x509_crt_t cert;
+  if (gnutls_x509_crt_init (&cert) >= 0) // All
+  {
+    if (gnutls_x509_crt_import (cert, &peers[0], GNUTLS_X509_FMT_DER) >= 0) // All
+      expires = gnutls_x509_crt_get_expiration_time (cert); // All
+
+    gnutls_x509_crt_deinit (cert); // All
+  }
+
+  return std::string ((const char*) digest, length);
+}
 
 ////////////////////////////////////////////////////////////////////////////////
 TLSServer::TLSServer ()
@@ -161,6 +249,28 @@ void TLSServer::dh_bits (unsigned int dh_bits)
   _dh_bits = dh_bits;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Where GnuTLS lacks built-in DH parameters, generated ones are cached in the
+// directory, one file per size, and regenerated once older than 'lifetime'
+// days.  A lifetime of zero keeps them indefinitely.
+void TLSServer::dh_cache (const std::string& directory, int lifetime)
+{
+  _dh_dir      = directory;
+  _dh_lifetime = lifetime;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void TLSServer::verifyCache (int seconds)
+{
+  _verify_ttl = seconds;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void TLSServer::reusePort (bool value)
+{
+  _reuse_port = value;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void TLSServer::init (
   const std::string& ca,
@@ -185,10 +295,15 @@ void TLSServer::init (
     throw format ("TLS allocation error. {1}", gnutls_strerror (ret)); // All
 
 #if GNUTLS_VERSION_NUMBER >= 0x030014
-  // Automatic loading of system installed CA certificates.
-  ret = gnutls_certificate_set_x509_system_trust (_credentials); // 3.0.20
-  if (ret < 0)
-    throw format ("Bad System Trust. {1}", gnutls_strerror (ret)); // All
+  // Automatic loading of system installed CA certificates, only when there is
+  // no CA of our own.  Client certificates are issued by that CA, and parsing
+  // the whole system store is a large part of the startup time.
+  if (_ca == "")
+  {
+    ret = gnutls_certificate_set_x509_system_trust (_credentials); // 3.0.20
+    if (ret < 0)
+      throw format ("Bad System Trust. {1}", gnutls_strerror (ret)); // All
+  }
 #endif
 
   if (_ca != "" &&
@@ -225,21 +340,41 @@ void TLSServer::init (
   ret = gnutls_dh_params_init (&params); // All
   if (ret < 0)
     throw format ("couldn't initialize DH parameters: {1}", gnutls_strerror (ret));
-  ret = gnutls_dh_params_generate2 (params, _dh_bits); // All
-  if (ret < 0)
-    throw format ("couldn't generate DH parameters: {1}", gnutls_strerror (ret));
+
+  // Generating the primes takes from seconds to minutes, so they are cached
+  // across restarts.  Stale parameters are still used, while replacements are
+  // generated in the background for the next start.
+  std::string cache = _dh_dir == "" ? "" : format ("{1}/dh.{2}.pem", _dh_dir, _dh_bits);
+  struct stat info;
+  if (cache != "" &&
+      load_dh_params (params, cache))
+  {
+    if (_dh_lifetime > 0 &&
+        ::stat (cache.c_str (), &info) == 0 &&
+        info.st_mtime + _dh_lifetime * 86400 < time (NULL))
+      std::thread (regenerate_dh_params, _dh_bits, cache).detach ();
+  }
+  else
+  {
+    ret = gnutls_dh_params_generate2 (params, _dh_bits); // All
+    if (ret < 0)
+      throw format ("couldn't generate DH parameters: {1}", gnutls_strerror (ret));
+
+    if (cache != "")
+      save_dh_params (params, cache);
+  }
+
   gnutls_certificate_set_dh_params (_credentials, params); // All
 #endif
 
-#if GNUTLS_VERSION_NUMBER < 0x030406
 #if GNUTLS_VERSION_NUMBER >= 0x020a00
   // The automatic verification for the client certificate with
   // gnutls_certificate_set_verify_function only works with gnutls
   // >=2.10.0. So with older versions we should call the verify function
-  // manually after the gnutls handshake.
+  // manually after the gnutls handshake.  Requiring a client certificate does
+  // not verify it, with any version.
   gnutls_certificate_set_verify_function (_credentials, verify_certificate_callback); // 2.10.0
 #endif
-#endif
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -303,6 +438,18 @@ void TLSServer::bind (
                     sizeof (on)) == -1)
     throw std::string (::strerror (errno));
 
+#ifdef SO_REUSEPORT
+  // Several processes may each bind the port, and the kernel distributes the
+  // incoming connections among them.
+  if (_reuse_port &&
+      ::setsockopt (_socket,
+                    SOL_SOCKET,
+                    SO_REUSEPORT,
+                    (const void*) &on,
+                    sizeof (on)) == -1)
+    throw std::string (::strerror (errno));
+#endif
+
   // Also listen to IPv4 with IPv6 in dual-stack situations
   if (res->ai_family == AF_INET6)
   {
@@ -333,17 +480,126 @@ void TLSServer::listen ()
   if (::listen (_socket, _queue) < 0)
     throw std::string (::strerror (errno));
 
+  adopt (_socket);
+
   if (_debug)
     std::cout << "s: INFO Server listening.\n";
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-void TLSServer::accept (TLSTransaction& tx)
+// Uses an already listening socket, such as one handed over by a predecessor,
+// in place of bind and listen.  The socket is made non-blocking, so that
+// several threads or processes may wait on it, and is not inherited by exec.
+void TLSServer::adopt (int socket)
+{
+  _socket = socket;
+
+  if (::fcntl (_socket, F_SETFL, ::fcntl (_socket, F_GETFL) | O_NONBLOCK) == -1 ||
+      ::fcntl (_socket, F_SETFD, FD_CLOEXEC) == -1)
+    throw std::string (::strerror (errno));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int TLSServer::descriptor () const
+{
+  return _socket;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Waits up to 'timeout' milliseconds for a connection.
+bool TLSServer::ready (int timeout)
+{
+  struct pollfd listener {_socket, POLLIN, 0};
+  return ::poll (&listener, 1, timeout) > 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Returns false if there was no connection to accept, because another thread
+// or process took it.
+bool TLSServer::accept (TLSTransaction& tx)
 {
   if (_debug)
     tx.debug ();
 
-  tx.init (*this);
+  return tx.init (*this);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Looks up a cached verification status.  A change to the CA or CRL file
+// discards every cached result.
+bool TLSServer::verified (const std::string& fingerprint, unsigned int& status)
+{
+  auto sources = sourcesModified ();
+
+  std::lock_guard <std::mutex> lock (_verify_mutex);
+  if (sources != _verify_sources)
+  {
+    _verified.clear ();
+    _verify_sources = sources;
+    return false;
+  }
+
+  auto v = _verified.find (fingerprint);
+  if (v == _verified.end ())
+    return false;
+
+  if (v->second.expires <= time (NULL))
+  {
+    _verified.erase (v);
+    return false;
+  }
+
+  status = v->second.status;
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Results are kept for the configured time, but a valid result no longer than
+// the certificate itself.  Expired entries are pruned as the map grows.
+void TLSServer::remember (
+  const std::string& fingerprint,
+  unsigned int status,
+  time_t expires)
+{
+  auto now = time (NULL);
+  if (expires <= 0 ||
+      expires > now + _verify_ttl)
+    expires = now + _verify_ttl;
+
+  std::lock_guard <std::mutex> lock (_verify_mutex);
+  if (_verified.size () >= _verify_prune_at)
+  {
+    for (auto v = _verified.begin (); v != _verified.end (); )
+    {
+      if (v->second.expires <= now)
+        v = _verified.erase (v);
+      else
+        ++v;
+    }
+
+    _verify_prune_at = _verified.size () * 2 < 1024 ? 1024 : _verified.size () * 2;
+  }
+
+  _verified[fingerprint] = Verification {status, expires};
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// The latest modification time of the CA and CRL files.
+time_t TLSServer::sourcesModified () const
+{
+  time_t latest = 0;
+  struct stat info;
+  if (_ca != "" &&
+      ::stat (_ca.c_str (), &info) == 0 &&
+      info.st_mtime > latest)
+    latest = info.st_mtime;
+
+  if (_crl != "" &&
+      ::stat (_crl.c_str (), &info) == 0 &&
+      info.st_mtime > latest)
+    latest = info.st_mtime;
+
+  return latest;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -360,8 +616,65 @@ TLSTransaction::~TLSTransaction ()
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-void TLSTransaction::init (TLSServer& server)
+// An IPv4 client of a dual-stack IPv6 listener has an IPv4-mapped address,
+// such as ::ffff:192.0.2.1, which is reported as the IPv4 address it maps, so
+// that a client has one address whichever way it connects.
+static void peerAddress (
+  const struct sockaddr_storage& peer,
+  std::string& address,
+  int& port)
 {
+  char buffer[INET6_ADDRSTRLEN] {};
+  if (peer.ss_family == AF_INET6)
+  {
+    auto ipv6 = (const struct sockaddr_in6*) &peer;
+    port = ntohs (ipv6->sin6_port);
+    if (IN6_IS_ADDR_V4MAPPED (&ipv6->sin6_addr))
+      inet_ntop (AF_INET, ipv6->sin6_addr.s6_addr + 12, buffer, sizeof (buffer));
+    else
+      inet_ntop (AF_INET6, &ipv6->sin6_addr, buffer, sizeof (buffer));
+  }
+  else if (peer.ss_family == AF_INET)
+  {
+    auto ipv4 = (const struct sockaddr_in*) &peer;
+    port = ntohs (ipv4->sin_port);
+    inet_ntop (AF_INET, &ipv4->sin_addr, buffer, sizeof (buffer));
+  }
+  else
+    port = 0;
+
+  address = buffer;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool TLSTransaction::init (TLSServer& server)
+{
+  struct sockaddr_storage sa_cli {};
+  socklen_t client_len = sizeof sa_cli;
+  do
+  {
+    _socket = accept (server._socket, (struct sockaddr *) &sa_cli, &client_len);
+  }
+  while (_socket < 0 && errno == EINTR);
+
+  if (_socket < 0)
+  {
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ECONNABORTED)
+    {
+      _socket = 0;
+      return false;
+    }
+
+    throw std::string (::strerror (errno));
+  }
+
+  // Unlike the listening socket, the connection blocks.
+  if (::fcntl (_socket, F_SETFL, ::fcntl (_socket, F_GETFL) & ~O_NONBLOCK) == -1 ||
+      ::fcntl (_socket, F_SETFD, FD_CLOEXEC) == -1)
+    throw std::string (::strerror (errno));
+
+  _server = &server;
+
   int ret = gnutls_init (&_session, GNUTLS_SERVER); // All
   if (ret < 0)
     throw format ("TLS server init error. {1}", gnutls_strerror (ret)); // All
@@ -388,21 +701,8 @@ void TLSTransaction::init (TLSServer& server)
   gnutls_session_enable_compatibility_mode (_session);
 */
 
-  struct sockaddr_in sa_cli {};
-  socklen_t client_len = sizeof sa_cli;
-  do
-  {
-    _socket = accept (server._socket, (struct sockaddr *) &sa_cli, &client_len);
-  }
-  while (errno == EINTR);
-
-  if (_socket < 0)
-    throw std::string (::strerror (errno));
-
   // Obtain client info.
-  char topbuf[512];
-  _address = inet_ntop (AF_INET, &sa_cli.sin_addr, topbuf, sizeof (topbuf));
-  _port    = ntohs (sa_cli.sin_port);
+  peerAddress (sa_cli, _address, _port);
   if (_debug)
     std::cout << "s: INFO connection from "
               << _address
@@ -432,14 +732,13 @@ void TLSTransaction::init (TLSServer& server)
       auto status = gnutls_session_get_verify_cert_status (_session); // 3.4.6
       gnutls_datum_t out;
       gnutls_certificate_verification_status_print (status, type, &out, 0);  // 3.1.4
-      gnutls_free (out.data); // All
 
       std::string error {(const char*) out.data};
+      gnutls_free (out.data); // All
       throw format ("Handshake failed. {1}", error);
     }
-#else
-    throw format ("Handshake failed. {1}", gnutls_strerror (ret)); // All
 #endif
+    throw format ("Handshake failed. {1}", gnutls_strerror (ret)); // All
   }
 
 #if GNUTLS_VERSION_NUMBER < 0x02090a
@@ -466,6 +765,8 @@ void TLSTransaction::init (TLSServer& server)
     std::cout << "s: INFO Handshake was completed.\n";
 #endif
   }
+
+  return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -500,6 +801,25 @@ int TLSTransaction::verify_certificate () const
   if (_trust == TLSServer::allow_all)
     return 0;
 
+  // Repeat clients present the same certificate, so a recent result for it
+  // stands in for building the chain and scanning the CRL again.
+  std::string fingerprint;
+  time_t expires = 0;
+  if (_server && _server->_verify_ttl > 0)
+  {
+    fingerprint = peer_fingerprint (_session, expires);
+
+    unsigned int cached;
+    if (fingerprint != "" &&
+        _server->verified (fingerprint, cached))
+    {
+      if (_debug)
+        std::cout << "s: INFO Certificate verification cached, status=" << cached << '\n';
+
+      return cached == 0 ? 0 : GNUTLS_E_CERTIFICATE_ERROR;
+    }
+  }
+
   if (_debug)
     std::cout << "s: INFO Verifying certificate.\n";
 
@@ -588,6 +908,9 @@ int TLSTransaction::verify_certificate () const
   gnutls_free (out.data);
 #endif
 
+  if (fingerprint != "")
+    _server->remember (fingerprint, status, status == 0 ? expires : 0);
+
   if (status != 0)
     return GNUTLS_E_CERTIFICATE_ERROR;
 
@@ -637,7 +960,15 @@ void TLSTransaction::send (const std::string& data)
 ////////////////////////////////////////////////////////////////////////////////
 void TLSTransaction::recv (std::string& data)
 {
-  data = "";          // No appending of data.
+  recvBody (data, recvHeader ());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Reads only the 4-byte length that precedes a request, so that the caller may
+// decide how to treat the request before reading the rest.  The length includes
+// the 4 bytes.
+unsigned long TLSTransaction::recvHeader ()
+{
   int received = 0;
 
   // Get the encoded length.
@@ -650,7 +981,7 @@ void TLSTransaction::recv (std::string& data)
          (errno == GNUTLS_E_INTERRUPTED ||
           errno == GNUTLS_E_AGAIN));
 
-  int total = received;
+  _total = received;
 
   // Decode the length.
   unsigned long expected = (header[0]<<24) |
@@ -662,6 +993,16 @@ void TLSTransaction::recv (std::string& data)
 
   // TODO This would be a good place to assert 'expected < _limit'.
 
+  return expected;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void TLSTransaction::recvBody (std::string& data, unsigned long expected)
+{
+  data = "";          // No appending of data.
+  int received = 0;
+  int total = _total;
+
   // Arbitrary buffer size.
   char buffer[MAX_BUF];
 
@@ -695,9 +1036,12 @@ void TLSTransaction::recv (std::string& data)
     else if (received < 0)
       throw std::string (gnutls_strerror (received)); // All
 
-    buffer [received] = '\0';
-    data += buffer;
-    total += received;
+    // The payload may be binary, so it is appended by length.
+    if (received > 0)
+    {
+      data.append (buffer, received);
+      total += received;
+    }
 
     // Stop at defined limit.
     if (_limit && total > _limit)
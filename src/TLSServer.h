@@ -29,6 +29,9 @@
 #ifdef HAVE_LIBGNUTLS
 
 #include <string>
+#include <unordered_map>
+#include <mutex>
+#include <time.h>
 #include <gnutls/gnutls.h>
 
 class TLSTransaction;
@@ -46,27 +49,53 @@ public:
   void trust (const enum trust_level);
   void ciphers (const std::string&);
   void dh_bits (unsigned int dh_bits);
+  void dh_cache (const std::string&, int);
+  void verifyCache (int);
+  void reusePort (bool);
   void init (const std::string&, const std::string&, const std::string&, const std::string&);
   void bind (const std::string&, const std::string&, const std::string&);
   void listen ();
-  void accept (TLSTransaction&);
+  void adopt (int);
+  int descriptor () const;
+  bool ready (int);
+  bool accept (TLSTransaction&);
 
   friend class TLSTransaction;
 
 private:
+  bool verified (const std::string&, unsigned int&);
+  void remember (const std::string&, unsigned int, time_t);
+  time_t sourcesModified () const;
+
+  struct Verification
+  {
+    unsigned int status;
+    time_t       expires;
+  };
+
   std::string                      _ca          {""};
   std::string                      _crl         {""};
   std::string                      _cert        {""};
   std::string                      _key         {""};
   std::string                      _ciphers     {""};
   unsigned int                     _dh_bits     {0};
+  std::string                      _dh_dir      {""};
+  int                              _dh_lifetime {0};
   gnutls_certificate_credentials_t _credentials {};
   gnutls_priority_t                _priorities  {};
   int                              _socket      {0};
   int                              _queue       {5};
   bool                             _debug       {false};
+  bool                             _reuse_port  {false};
   enum trust_level                 _trust       {TLSServer::strict};
   bool                             _priorities_init {false};
+
+  // Client certificate verification results, by certificate fingerprint.
+  std::mutex                       _verify_mutex   {};
+  int                              _verify_ttl     {0};
+  time_t                           _verify_sources {0};
+  size_t                           _verify_prune_at {1024};
+  std::unordered_map <std::string, Verification> _verified {};
 };
 
 class TLSTransaction
@@ -74,7 +103,7 @@ class TLSTransaction
 public:
   TLSTransaction () = default;
   ~TLSTransaction ();
-  void init (TLSServer&);
+  bool init (TLSServer&);
   void bye ();
   void debug ();
   void trust (const enum TLSServer::trust_level);
@@ -82,13 +111,17 @@ public:
   int verify_certificate () const;
   void send (const std::string&);
   void recv (std::string&);
+  unsigned long recvHeader ();
+  void recvBody (std::string&, unsigned long);
   void getClient (std::string&, int&);
 
 private:
   int                         _socket  {0};
+  TLSServer*                  _server  {nullptr};
   gnutls_session_t            _session {};
   int                         _limit   {0};
   bool                        _debug   {false};
+  int                         _total   {0};
   std::string                 _address {""};
   int                         _port    {0};
   enum TLSServer::trust_level _trust   {TLSServer::strict};
@@ -64,6 +64,28 @@ extern Task& contextTask;
 static const float epsilon = 0.000001;
 #endif
 
+////////////////////////////////////////////////////////////////////////////////
+// Dates on the wire are YYYYMMDDTHHMMSSZ, which has a fast path.  Anything else
+// goes through the general Datetime parser.
+static std::string isoToEpoch (const std::string& text)
+{
+  std::string epoch;
+  if (parseISO (text, epoch))
+    return epoch;
+
+  return Datetime (text).toEpochString ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static std::string epochToISO (const std::string& epoch)
+{
+  std::string iso;
+  if (composeISO (epoch, iso))
+    return iso;
+
+  return Datetime (epoch).toISO ();
+}
+
 std::string Task::defaultProject   = "";
 std::string Task::defaultDue       = "";
 std::string Task::defaultScheduled = "";
@@ -72,6 +94,7 @@ bool Task::regex                   = false;
 std::map <std::string, std::string> Task::attributes;
 
 std::map <std::string, float> Task::coefficients;
+
 float Task::urgencyProjectCoefficient     = 0.0;
 float Task::urgencyActiveCoefficient      = 0.0;
 float Task::urgencyScheduledCoefficient   = 0.0;
@@ -163,6 +186,18 @@ std::string Task::statusToText (Task::status s)
   return "pending";
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Looks up the type of an attribute, without copying it, and without inserting
+// unrecognized names into Task::attributes, as operator[] would.  Returns an
+// empty string for orphans and annotations.
+const std::string& Task::attributeType (const std::string& name)
+{
+  static const std::string none;
+
+  auto i = Task::attributes.find (name);
+  return i != Task::attributes.end () ? i->second : none;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Returns a proper handle to the task. Tasks should not be referenced by UUIDs
 // as long as they have non-zero ID.
@@ -529,7 +564,7 @@ bool Task::is_udaPresent () const
 bool Task::is_orphanPresent () const
 {
   for (auto& att : data)
-    if (att.first.compare (0, 11, "annotation_", 11) != 0)
+    if (att.first.str ().compare (0, 11, "annotation_", 11) != 0)
       if (Context::getContext ().columns.find (att.first) == Context::getContext ().columns.end ())
         return true;
 
@@ -651,7 +686,7 @@ void Task::parseJSON (const json::object* root_obj)
   for (auto& i : root_obj->_data)
   {
     // If the attribute is a recognized column.
-    std::string type = Task::attributes[i.first];
+    auto& type = Task::attributeType (i.first);
     if (type != "")
     {
       // Any specified id is ignored.
@@ -665,16 +700,14 @@ void Task::parseJSON (const json::object* root_obj)
       // TW-1274 Standardization.
       else if (i.first == "modification")
       {
-        Datetime d (Lexer::dequote (i.second->dump ()));
-        set ("modified", d.toEpochString ());
+        set ("modified", isoToEpoch (Lexer::dequote (i.second->dump ())));
       }
 
       // Dates are converted from ISO to epoch.
       else if (type == "date")
       {
         auto text = Lexer::dequote (i.second->dump ());
-        Datetime d (text);
-        set (i.first, text == "" ? "" : d.toEpochString ());
+        set (i.first, text == "" ? "" : isoToEpoch (text));
       }
 
       // Tags are an array of JSON strings.
@@ -753,7 +786,7 @@ void Task::parseJSON (const json::object* root_obj)
           if (! what)
             throw format ("Annotation is missing a description: {1}", root_obj->dump ());
 
-          std::string name = "annotation_" + Datetime (when->_data).toEpochString ();
+          std::string name = "annotation_" + isoToEpoch (when->_data);
           annos.insert (std::make_pair (name, json::decode (what->_data)));
         }
 
@@ -822,12 +855,10 @@ std::string Task::composeF4 () const
   std::string ff4 = "[";
 
   bool first = true;
-  for (auto it : data)
+  for (auto& it : data)
   {
     // Orphans have no type, treat as string.
-    std::string type = Task::attributes[it.first];
-    if (type == "")
-      type = "string";
+    auto& type = Task::attributeType (it.first);
 
     // If there is a value.
     if (it.second != "")
@@ -835,7 +866,7 @@ std::string Task::composeF4 () const
       ff4 += (first ? "" : " ");
       ff4 += it.first;
       ff4 += ":\"";
-      if (type == "string")
+      if (type == "string" || type == "")
         ff4 += encode (json::encode (it.second));
       else
         ff4 += it.second;
@@ -865,7 +896,7 @@ std::string Task::composeJSON (bool decorate /*= false*/) const
   for (auto& i : data)
   {
     // Annotations are not written out here.
-    if (! i.first.compare (0, 11, "annotation_", 11))
+    if (! i.first.str ().compare (0, 11, "annotation_", 11))
       continue;
 
     // If value is an empty string, do not ever output it
@@ -875,19 +906,17 @@ std::string Task::composeJSON (bool decorate /*= false*/) const
     if (attributes_written)
       out << ',';
 
-    std::string type = Task::attributes[i.first];
-    if (type == "")
-      type = "string";
+    // Orphans have no type, treat as string.
+    auto& type = Task::attributeType (i.first);
 
     // Date fields are written as ISO 8601.
     if (type == "date")
     {
-      Datetime d (i.second);
       out << '"'
           << (i.first == "modification" ? "modified" : i.first)
           << "\":\""
           // Date was deleted, do not export parsed empty string
-          << (i.second == "" ? "" : d.toISO ())
+          << (i.second == "" ? "" : epochToISO (i.second))
           << '"';
 
       ++attributes_written;
@@ -974,7 +1003,7 @@ std::string Task::composeJSON (bool decorate /*= false*/) const
       out << '"'
           << i.first
           << "\":\""
-          << (type == "string" ? json::encode (i.second) : i.second)
+          << (type == "string" || type == "" ? json::encode (i.second) : i.second)
           << '"';
 
       ++attributes_written;
@@ -990,14 +1019,13 @@ std::string Task::composeJSON (bool decorate /*= false*/) const
     int annotations_written = 0;
     for (auto& i : data)
     {
-      if (! i.first.compare (0, 11, "annotation_", 11))
+      if (! i.first.str ().compare (0, 11, "annotation_", 11))
       {
         if (annotations_written)
           out << ',';
 
-        Datetime d (i.first.substr (11));
         out << "{\"entry\":\""
-            << d.toISO ()
+            << epochToISO (i.first.str ().substr (11))
             << "\",\"description\":\""
             << json::encode (i.second)
             << "\"}";
@@ -1026,7 +1054,7 @@ int Task::getAnnotationCount () const
 {
   int count = 0;
   for (auto& ann : data)
-    if (! ann.first.compare (0, 11, "annotation_", 11))
+    if (! ann.first.str ().compare (0, 11, "annotation_", 11))
       ++count;
 
   return count;
@@ -1068,7 +1096,7 @@ void Task::removeAnnotations ()
   auto i = data.begin ();
   while (i != data.end ())
   {
-    if (! i->first.compare (0, 11, "annotation_", 11))
+    if (! i->first.str ().compare (0, 11, "annotation_", 11))
     {
       --annotation_count;
       data.erase (i++);
@@ -1085,7 +1113,7 @@ std::map <std::string, std::string> Task::getAnnotations () const
 {
   std::map <std::string, std::string> a;
   for (auto& ann : data)
-    if (! ann.first.compare (0, 11, "annotation_", 11))
+    if (! ann.first.str ().compare (0, 11, "annotation_", 11))
       a.insert (ann);
 
   return a;
@@ -1341,7 +1369,7 @@ std::vector <std::string> Task::getUDAOrphanUUIDs () const
 {
   std::vector <std::string> orphans;
   for (auto& it : data)
-    if (it.first.compare (0, 11, "annotation_", 11) != 0)
+    if (it.first.str ().compare (0, 11, "annotation_", 11) != 0)
       if (Context::getContext ().columns.find (it.first) == Context::getContext ().columns.end ())
         orphans.push_back (it.first);
 
@@ -1483,13 +1511,18 @@ void Task::validate (bool applyDefault /* = true */)
   // 1) Provide missing attributes where possible
   // Provide a UUID if necessary. Validate if present.
   std::string uid = get ("uuid");
+  UUID128 id;
   if (has ("uuid") && uid != "")
   {
-    Lexer lex (uid);
-    std::string token;
-    Lexer::Type type;
-    if (! lex.isUUID (token, type, true))
-      throw format ("Not a valid UUID '{1}'.", uid);
+    // Canonical UUIDs, which is all of them in practice, need no Lexer.
+    if (! parseUUID (uid, id))
+    {
+      Lexer lex (uid);
+      std::string token;
+      Lexer::Type type;
+      if (! lex.isUUID (token, type, true))
+        throw format ("Not a valid UUID '{1}'.", uid);
+    }
   }
   else
     set ("uuid", uuid ());
@@ -33,6 +33,7 @@
 #include <stdio.h>
 #include <time.h>
 #include <JSON.h>
+#include <Symbol.h>
 
 class Task
 {
@@ -74,7 +75,7 @@ public:
   enum dateState {dateNotDue, dateAfterToday, dateLaterToday, dateEarlierToday, dateBeforeToday};
 
   // Public data.
-  std::map <std::string, std::string> data {};
+  std::map <Symbol, std::string> data      {};
   int id                                   {0};
   float urgency_value                      {0.0};
   bool recalc_urgency                      {true};
@@ -85,6 +86,7 @@ public:
   // Series of helper functions.
   static status textToStatus (const std::string&);
   static std::string statusToText (status);
+  static const std::string& attributeType (const std::string&);
 
   void setAsNow (const std::string&);
   bool has (const std::string&) const;
@@ -0,0 +1,150 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2010 - 2018, Göteborg Bit Factory.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// http://www.opensource.org/licenses/mit-license.php
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cmake.h>
+#include <TxData.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+
+////////////////////////////////////////////////////////////////////////////////
+TxData::~TxData ()
+{
+  close ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Maps the file.  An empty file needs no mapping.  Returns false on failure,
+// with errno set.
+bool TxData::open (const std::string& path)
+{
+  close ();
+
+  int fd = ::open (path.c_str (), O_RDONLY);
+  if (fd == -1)
+    return false;
+
+  struct stat st;
+  if (fstat (fd, &st) == -1)
+  {
+    ::close (fd);
+    return false;
+  }
+
+  _length = (size_t) st.st_size;
+  if (_length)
+  {
+#ifdef POSIX_FADV_SEQUENTIAL
+    // The whole history is scanned front to back, at least once.
+    posix_fadvise (fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    void* map = mmap (nullptr, _length, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+    {
+      _length = 0;
+      ::close (fd);
+      return false;
+    }
+
+#ifdef MADV_WILLNEED
+    madvise (map, _length, MADV_WILLNEED);
+#endif
+
+    _map = (const char*) map;
+  }
+
+  ::close (fd);
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void TxData::close ()
+{
+  if (_map)
+    munmap ((void*) _map, _length);
+
+  _map = nullptr;
+  _length = 0;
+  _offsets.clear ();
+  _indexed = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+size_t TxData::size () const
+{
+  index ();
+  return _offsets.size () ? _offsets.size () - 1 : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+StringView TxData::operator[] (size_t line) const
+{
+  index ();
+  return StringView (_map + _offsets[line],
+                     _offsets[line + 1] - _offsets[line] - 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// True if the file ends in a partial line.
+bool TxData::torn () const
+{
+  index ();
+  return (_offsets.size () ? _offsets.back () : 0) < _length;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Records the offset of the start of every line, followed by one past the end
+// of the last complete line.
+void TxData::index () const
+{
+  if (_indexed)
+    return;
+
+  _indexed = true;
+  if (! _map)
+    return;
+
+  _offsets.reserve (_length / 256 + 2);
+  _offsets.push_back (0);
+
+  const char* next = _map;
+  const char* end  = _map + _length;
+  while (next < end)
+  {
+    auto newline = (const char*) memchr (next, '\n', end - next);
+    if (! newline)
+      break;
+
+    next = newline + 1;
+    _offsets.push_back (next - _map);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,65 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2010 - 2018, Göteborg Bit Factory.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// http://www.opensource.org/licenses/mit-license.php
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef INCLUDED_TXDATA
+#define INCLUDED_TXDATA
+
+#include <string>
+#include <vector>
+#include <StringView.h>
+
+// A read-only, memory-mapped view of a tx.data file.  Lines are located on
+// first use, and are returned as views into the mapping, without the newline.
+// A final line with no newline was torn by a crash during an append, and is
+// not included.
+class TxData
+{
+public:
+  TxData () = default;
+  TxData (const TxData&) = delete;
+  TxData& operator= (const TxData&) = delete;
+  ~TxData ();
+
+  bool open (const std::string&);
+  void close ();
+
+  size_t size () const;
+  StringView operator[] (size_t) const;
+  size_t bytes () const { return _length; }
+  bool torn () const;
+
+private:
+  void index () const;
+
+private:
+  const char* _map {nullptr};
+  size_t _length   {0};
+  mutable std::vector <size_t> _offsets {};
+  mutable bool _indexed                 {false};
+};
+
+#endif
+////////////////////////////////////////////////////////////////////////////////
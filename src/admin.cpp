@@ -26,10 +26,15 @@
 
 #include <cmake.h>
 #include <iostream>
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <thread>
 #include <stdlib.h>
 #include <ConfigFile.h>
 #include <taskd.h>
 #include <shared.h>
+#include <format.h>
 
 ////////////////////////////////////////////////////////////////////////////////
 // taskd add org  <org>
@@ -312,3 +317,170 @@ void command_resume (Database& db, const std::vector <std::string>& args)
 }
 
 ////////////////////////////////////////////////////////////////////////////////
+// taskd import users <file>
+//
+// Reads '<org>,<user>' or '<org><TAB><user>' lines, creates any missing orgs
+// and all the users, and writes '<org><TAB><user><TAB><key>' lines to stdout.
+// Every row is validated before anything is created.  Orgs are independent, so
+// with --jobs=N they are provisioned by N threads, each rewriting its org's
+// users.index once rather than once per user.
+void command_import (Database& db, const std::vector <std::string>& args)
+{
+  auto verbose = db._config->getBoolean ("verbose");
+
+  // Verify that root exists.
+  auto root = db._config->get ("root");
+  if (root == "")
+    throw std::string ("ERROR: The '--data' option is required.");
+
+  Directory root_dir (root);
+  if (!root_dir.exists ())
+    throw std::string ("ERROR: The '--data' path does not exist.");
+
+  if (args.size () < 2)
+    throw std::string ("ERROR: Subcommand not specified - expected 'users'.");
+
+  if (! closeEnough ("users", args[1], 3))
+    throw std::string ("ERROR: Unrecognized argument '") + args[1] + "'";
+
+  if (args.size () != 3)
+    throw std::string ("Usage: taskd import [options] users <file>");
+
+  std::vector <std::string> lines;
+  if (! File::read (args[2], lines))
+    throw format ("ERROR: Could not read '{1}'.", args[2]);
+
+  // Group the users by org, preserving file order within each org.
+  std::map <std::string, std::vector <std::string>> accounts;
+  std::set <std::string> seen;
+  int line_number = 0;
+  for (auto& line : lines)
+  {
+    ++line_number;
+    auto row = trim (line);
+    if (row == "" || row[0] == '#')
+      continue;
+
+    auto separator = row.find ('\t');
+    if (separator == std::string::npos)
+      separator = row.find (',');
+
+    if (separator == std::string::npos)
+      throw format ("ERROR: {1}:{2} Expected '<org>,<user>'.", args[2], line_number);
+
+    auto org  = trim (row.substr (0, separator));
+    auto user = trim (row.substr (separator + 1));
+
+    // Tolerate a header row.
+    if (org == "org" && user == "user")
+      continue;
+
+    if (org == "" || user == "")
+      throw format ("ERROR: {1}:{2} Expected '<org>,<user>'.", args[2], line_number);
+
+    if (! seen.insert (org + '\t' + user).second)
+      throw format ("ERROR: {1}:{2} User '{3}' is listed twice for organization '{4}'.", args[2], line_number, user, org);
+
+    accounts[org].push_back (user);
+  }
+
+  // Load each org's index once, and refuse to create any duplicates.  Each
+  // index stays locked until it is saved.
+  std::vector <std::string> orgs;
+  std::map <std::string, std::map <std::string, std::string>> indexes;
+  std::map <std::string, File> locks;
+  for (auto& account : accounts)
+  {
+    auto& org = account.first;
+    auto& index = indexes[org];
+    orgs.push_back (org);
+
+    if (taskd_is_org (root_dir, org))
+    {
+      taskd_lock_user_index (root_dir, org, locks[org]);
+      taskd_load_user_index (root_dir, org, index);
+      for (auto& user : account.second)
+        if (index.find (user) != index.end ())
+          throw format ("ERROR: User '{1}' already exists in organization '{2}'.", user, org);
+    }
+  }
+
+  for (auto& org : orgs)
+  {
+    if (! taskd_is_org (root_dir, org))
+    {
+      if (! db.add_org (org))
+        throw std::string ("ERROR: Failed to create organization '") + org + "'.";
+
+      if (verbose)
+        std::cerr << "Created organization '" << org << "'\n";
+
+      taskd_lock_user_index (root_dir, org, locks[org]);
+    }
+  }
+
+  // Each worker claims whole orgs, so no index is shared between threads.
+  std::vector <std::vector <std::string>> created (orgs.size ());
+  std::atomic <size_t> next {0};
+  std::mutex error_mutex;
+  std::string error;
+
+  auto worker = [&] ()
+  {
+    size_t i;
+    while ((i = next++) < orgs.size ())
+    {
+      auto& org = orgs[i];
+      auto& index = indexes.at (org);
+      for (auto& user : accounts.at (org))
+      {
+        auto key = db.key_generate ();
+        if (! db.add_user (org, user, key))
+        {
+          std::lock_guard <std::mutex> lock (error_mutex);
+          error = std::string ("ERROR: Failed to create user '") + user + "'.";
+          break;
+        }
+
+        index[user] = key;
+        created[i].push_back (org + '\t' + user + '\t' + key);
+      }
+
+      taskd_save_user_index (root_dir, org, index);
+    }
+  };
+
+  size_t jobs = std::max (db._config->getInteger ("jobs"), 1);
+  if (jobs > orgs.size ())
+    jobs = orgs.size ();
+
+  if (jobs > 1)
+  {
+    std::vector <std::thread> threads;
+    for (size_t j = 0; j < jobs; ++j)
+      threads.push_back (std::thread (worker));
+
+    for (auto& thread : threads)
+      thread.join ();
+  }
+  else
+    worker ();
+
+  // Report every key that was issued, even if something later failed.
+  size_t count = 0;
+  for (auto& rows : created)
+  {
+    for (auto& row : rows)
+      std::cout << row << '\n';
+
+    count += rows.size ();
+  }
+
+  if (error != "")
+    throw error;
+
+  if (verbose)
+    std::cerr << "Created " << count << " users in " << orgs.size () << " organizations\n";
+}
+
+////////////////////////////////////////////////////////////////////////////////
@@ -30,7 +30,9 @@
 #include <cstring>
 #include <algorithm>
 #include <stdio.h>
+#include <errno.h>
 #include <inttypes.h>
+#include <sys/stat.h>
 #include <TLSClient.h>
 #include <FS.h>
 #include <Color.h>
@@ -119,6 +121,16 @@ void taskd_requireHeader (
     throw format ("ERROR: Message {1} should be '{2}'", name, value);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+void taskd_requireHeader (
+  const MsgView& message,
+  const std::string& name,
+  const std::string& value)
+{
+  if (message.get (name) != value)
+    throw format ("ERROR: Message {1} should be '{2}'", name, value);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Tests left >= right, where left and right are version number strings.
 // Assumes all versions are Major.Minor.Patch[other], such as '1.0.0' or
@@ -256,22 +268,183 @@ bool taskd_is_user (
   const std::string& org,
   const std::string& user)
 {
-  Directory d (root);
-  d += "orgs";
-  d += org;
-  d += "users";
+  if (! taskd_is_org (root, org))
+    return false;
+
+  std::map <std::string, std::string> index;
+  taskd_read_user_index (root, org, index);
+  return index.find (user) != index.end ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Anything that changes users.index, or rebuilds it, holds the lock from
+// taskd_load_user_index to the last taskd_save_user_index, so that concurrent
+// adds and removes cannot overwrite each other's changes.  Lookups use
+// taskd_read_user_index, and need no lock.  The lock is an
+// flock on 'users.index.lock', released when 'lock' is destroyed.
+void taskd_lock_user_index (
+  const Directory& root,
+  const std::string& org,
+  File& lock)
+{
+  lock = File (root);
+  lock += "orgs";
+  lock += org;
+  lock += "users.index.lock";
 
-  for (auto& u : d.list ())
+  if (! lock.exists ())
+    lock.create (0600);
+
+  if (! lock.open () ||
+      ! lock.lock ())
+    throw format ("ERROR: Could not lock '{1}': {2}", lock._data, strerror (errno));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Modification time with nanoseconds, or 0 if the path cannot be read.
+static long long mtime_ns (const std::string& path)
+{
+  struct stat info;
+  if (stat (path.c_str (), &info))
+    return 0;
+
+#if defined(DARWIN)
+  return info.st_mtimespec.tv_sec * 1000000000LL + info.st_mtimespec.tv_nsec;
+#else
+  return info.st_mtim.tv_sec * 1000000000LL + info.st_mtim.tv_nsec;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Each org keeps a 'users.index' file of '<key> <user>' lines, so that name
+// lookups do not have to parse every users/<key>/config file.  The index is
+// derived data: if it is missing, or older than the users directory (which
+// means a user directory was added or removed behind its back), it is stale.
+// Timestamps can be coarser than the time between two changes, so an index
+// that is not strictly newer than the users directory is treated as stale.
+//
+// Returns false if the index is stale, and leaves the map empty.
+static bool read_user_index (
+  const Directory& root,
+  const std::string& org,
+  std::map <std::string, std::string>& index)
+{
+  index.clear ();
+
+  Directory users (root);
+  users += "orgs";
+  users += org;
+  users += "users";
+
+  File file (root);
+  file += "orgs";
+  file += org;
+  file += "users.index";
+
+  if (! file.exists () ||
+      (users.exists () && mtime_ns (file._data) <= mtime_ns (users._data)))
+    return false;
+
+  std::vector <std::string> lines;
+  File::read (file._data, lines);
+  for (auto& line : lines)
+  {
+    auto space = line.find (' ');
+    if (space != std::string::npos)
+      index[line.substr (space + 1)] = line.substr (0, space);
+  }
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Builds the index from the per-user config files.  Returns false if the org
+// has no users directory.
+static bool scan_user_index (
+  const Directory& root,
+  const std::string& org,
+  std::map <std::string, std::string>& index)
+{
+  index.clear ();
+
+  Directory users (root);
+  users += "orgs";
+  users += org;
+  users += "users";
+
+  if (! users.exists ())
+    return false;
+
+  for (auto& u : users.list ())
   {
     Path cfg (u);
     cfg += "config";
 
     Config conf (cfg._data);
-    if (conf.get ("user") == user)
-      return true;
+    index[conf.get ("user")] = Path (u).name ();
   }
 
-  return false;
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Reads the index without locking or writing it, for lookups.  A stale index
+// is not rebuilt, and the per-user config files are read instead.  The map is
+// from user name to key.
+void taskd_read_user_index (
+  const Directory& root,
+  const std::string& org,
+  std::map <std::string, std::string>& index)
+{
+  if (! read_user_index (root, org, index))
+    scan_user_index (root, org, index);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Reads the index for a change, and rebuilds and rewrites it if it is stale.
+// The map is from user name to key.  The caller holds taskd_lock_user_index.
+void taskd_load_user_index (
+  const Directory& root,
+  const std::string& org,
+  std::map <std::string, std::string>& index)
+{
+  if (read_user_index (root, org, index))
+    return;
+
+  if (scan_user_index (root, org, index))
+    taskd_save_user_index (root, org, index);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Written to a temporary file and renamed into place, so a reader sees either
+// the old index or the new one, never a partial file.  The caller holds
+// taskd_lock_user_index.
+bool taskd_save_user_index (
+  const Directory& root,
+  const std::string& org,
+  const std::map <std::string, std::string>& index)
+{
+  File file (root);
+  file += "orgs";
+  file += org;
+  file += "users.index";
+
+  std::string contents;
+  for (auto& i : index)
+    contents += i.second + ' ' + i.first + '\n';
+
+  File temp (file._data + ".tmp");
+  if (temp.exists ())
+    temp.remove ();
+
+  if (! temp.create (0600) ||
+      ! File::write (temp._data, contents))
+  {
+    temp.remove ();
+    return false;
+  }
+
+  return temp.rename (file._data);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
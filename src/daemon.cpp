@@ -29,10 +29,17 @@
 #include <algorithm>
 #include <sstream>
 #include <cstring>
+#include <cmath>
+#include <chrono>
+#include <atomic>
+#include <mutex>
+#include <unordered_set>
 #include <stdlib.h>
 #include <inttypes.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include <Server.h>
 #include <Timer.h>
 #include <shared.h>
@@ -42,6 +49,10 @@
 #include <Log.h>
 #include <Color.h>
 #include <Task.h>
+#include <Daemon.h>
+#include <TxData.h>
+#include <Arena.h>
+#include <JSON.h>
 #ifdef HAVE_COMMIT
 #include <commit.h>
 #endif
@@ -49,57 +60,205 @@
 #include <taskd.h>
 
 // Indicates that signals were caught.
-extern bool _sighup;
-extern bool _sigusr1;
-extern bool _sigusr2;
+extern std::atomic <bool> _sighup;
+extern std::atomic <bool> _sigusr1;
+extern std::atomic <bool> _sigusr2;
 static Config _overrides;
 
 ////////////////////////////////////////////////////////////////////////////////
-class Daemon : public Server
-{
-public:
-  Daemon (Config&);
-  void handler (const std::string& input, std::string& output);
-
-private:
-  void handle_statistics (const Msg&, Msg&);
-  void handle_sync       (const Msg&, Msg&);
-
-private:
-  void parse_payload (const std::string&, std::vector <std::string>&, std::string&) const;
-  void load_server_data (const std::string&, const std::string&, std::vector <std::string>&) const;
-  void append_server_data (const std::string&, const std::string&, const std::vector <std::string>&) const;
-  unsigned int find_branch_point (const std::vector <std::string>&, const std::string&) const;
-  void extract_subset (const std::vector <std::string>&, const unsigned int, std::vector <Task>&) const;
-  bool contains (const std::vector <Task>&, const std::string&) const;
-  std::string generate_payload (const std::vector <Task>&, const std::vector <std::string>&, const std::string&) const;
-  unsigned int find_common_ancestor (const std::vector <std::string>&, unsigned int, const std::string&) const;
-  void get_client_mods (std::vector <Task>&, const std::vector <std::string>&, const std::string&) const;
-  void get_server_mods (std::vector <Task>&, const std::vector <std::string>&, const std::string&, unsigned int) const;
-  void merge_sort (const std::vector <Task>&, const std::vector <Task>&, Task&) const;
-  time_t last_modification (const Task&) const;
-  void patch (Task&, const Task&, const Task&) const;
-  void get_totals (long&, long&, long&);
-
-public:
-  Database _db;
-
-private:
-  Config& _config;
-  Datetime _start    {Datetime ()};
-  long _txn_count    {0};
-  long _error_count  {0};
-  double _busy       {0.0};
-  double _max_time   {0.0};
-  long _bytes_in     {0};
-  long _bytes_out    {0};
-};
+UUIDSet::UUIDSet (Arena& arena)
+: _values (0, UUID128Hash (), std::equal_to <UUID128> (), ArenaAllocator <UUID128> (arena))
+, _other (ArenaAllocator <std::string> (arena))
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Returns true if the UUID was not already present.
+bool UUIDSet::insert (const std::string& uuid)
+{
+  UUID128 id;
+  if (parseUUID (uuid, id))
+    return _values.insert (id).second;
+
+  if (std::find (_other.begin (), _other.end (), uuid) != _other.end ())
+    return false;
+
+  _other.push_back (uuid);
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool UUIDSet::contains (const std::string& uuid) const
+{
+  UUID128 id;
+  if (parseUUID (uuid, id))
+    return _values.find (id) != _values.end ();
+
+  return std::find (_other.begin (), _other.end (), uuid) != _other.end ();
+}
 
 ////////////////////////////////////////////////////////////////////////////////
 Daemon::Daemon (Config& settings)
 : _db (&settings)
 , _config (settings)
 {
+  configure_admission ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Rates are requests per second.  The pending limit defaults to 32 queued
+// requests, and zero means no limit.
+void Daemon::configure_admission ()
+{
+  std::lock_guard <std::mutex> lock (_admission_mutex);
+
+  _max_pending = _config.get ("admission.pending") == ""
+                 ? 32
+                 : _config.getInteger ("admission.pending");
+
+  auto address_rate = _config.getReal ("admission.address.rate");
+  auto org_rate     = _config.getReal ("admission.org.rate");
+  auto user_rate    = _config.getReal ("admission.user.rate");
+
+  _address_limits.configure (address_rate,
+                             _config.get ("admission.address.burst") == ""
+                             ? address_rate
+                             : _config.getReal ("admission.address.burst"));
+
+  _org_limits.configure (org_rate,
+                         _config.get ("admission.org.burst") == ""
+                         ? org_rate
+                         : _config.getReal ("admission.org.burst"));
+  _user_limits.configure (user_rate,
+                          _config.get ("admission.user.burst") == ""
+                          ? user_rate
+                          : _config.getReal ("admission.user.burst"));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// A 420 response, telling the client how many seconds to wait.
+static std::string refusal (double retry)
+{
+  Msg out;
+  out.set ("code",   420);
+  out.set ("status", taskd_error (420));
+  out.set ("retry",  std::max (1, (int) std::ceil (retry)));
+  return out.serialize ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Decides, before a request is read, whether its client address is over its
+// rate limit, and spends a token if not.  The address is the only thing known
+// about the client that it cannot choose.
+//
+// This runs on the accepting threads, concurrently with the handler.
+bool Daemon::admitAddress (
+  const std::string& address,
+  std::string& output)
+{
+  double retry = 0.0;
+  {
+    std::lock_guard <std::mutex> lock (_admission_mutex);
+    if (! _address_limits.enabled ())
+      return true;
+
+    auto now = std::chrono::duration <double> (std::chrono::steady_clock::now ().time_since_epoch ()).count ();
+    retry = _address_limits.wait (address, now);
+    if (retry == 0.0)
+    {
+      _address_limits.take (address, now);
+      return true;
+    }
+
+    ++_refused_count;
+  }
+
+  deferLog (format ("Refused request, rate limit for address {1}", address));
+  output = refusal (retry);
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Decides, before a request is queued for the handler, whether it should be
+// refused with a 420.  That happens when too many requests are already waiting,
+// or when the org or user is over its rate limit.  The 'retry' header tells the
+// client how many seconds to wait.  Only the headers are parsed here, and a
+// request that does not parse is admitted, for the handler to reject properly.
+//
+// The org and user headers are not yet authenticated, so their buckets are
+// only checked here, and charge () spends the tokens once the handler has
+// authenticated the request.  Otherwise anyone could drain a victim's bucket.
+//
+// This runs on the accepting threads, concurrently with the handler.
+bool Daemon::admit (
+  const std::string& input,
+  std::string& output,
+  int pending,
+  double wait)
+{
+  double retry = 0.0;
+  std::string reason;
+
+  {
+    std::lock_guard <std::mutex> lock (_admission_mutex);
+
+    if (_max_pending > 0 &&
+        pending >= _max_pending)
+    {
+      retry = wait;
+      reason = format ("{1} requests pending", pending);
+    }
+    else if (_org_limits.enabled () ||
+             _user_limits.enabled ())
+    {
+      MsgView in;
+      try
+      {
+        in.parse (input);
+      }
+
+      catch (...)
+      {
+        return true;
+      }
+
+      auto org  = in.get ("org").str ();
+      auto user = org + '\t' + in.get ("user").str ();
+      auto now  = std::chrono::duration <double> (std::chrono::steady_clock::now ().time_since_epoch ()).count ();
+
+      retry = std::max (_org_limits.wait (org, now),
+                        _user_limits.wait (user, now));
+      if (retry == 0.0)
+        return true;
+
+      reason = format ("rate limit for org '{1}' user '{2}'", org, in.get ("user").str ());
+    }
+    else
+      return true;
+
+    ++_refused_count;
+  }
+
+  deferLog (format ("Refused request, {1}", reason));
+  output = refusal (retry);
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Spends the org and user tokens of an authenticated request.  Requests that
+// were admitted together may overdraw a bucket, which then delays the next.
+void Daemon::charge (const std::string& org, const std::string& user)
+{
+  std::lock_guard <std::mutex> lock (_admission_mutex);
+  auto now = std::chrono::duration <double> (std::chrono::steady_clock::now ().time_since_epoch ()).count ();
+  _org_limits.take (org, now);
+  _user_limits.take (org + '\t' + user, now);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void Daemon::setPhaseHook (phase_hook hook)
+{
+  _phase = hook;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -143,6 +302,7 @@ void Daemon::handler (const std::string& input, std::string& output)
       for (auto& i : _overrides)
         _config[i.first] = i.second;
 
+      configure_admission ();
       _sigusr1 = false;
     }
 
@@ -155,8 +315,17 @@ void Daemon::handler (const std::string& input, std::string& output)
     timer.start ();
 
     // Request-specific processing here.
-    Msg in;
+    MsgView in;
     in.parse (input);
+
+    // The whole request must be UTF-8.  A compressed payload is verified once
+    // inflated, and protocol v2 records individually, because they are framed
+    // in binary.
+    auto binary = in.get ("compression") != "" || in.get ("protocol") == "v2";
+    if (! validUTF8 (input.data (), binary ? input.find ("\n\n") : input.length ()))
+      throw 401;
+
+    decompress_request (in);
     Msg out;
 
     // Handle or reject all message types.
@@ -166,11 +335,12 @@ void Daemon::handler (const std::string& input, std::string& output)
     else
     {
       if (_log)
-        _log->write (format ("[{1}] ERROR: Unrecognized message type '{2}'", _txn_count, type));
+        _log->write (format ("[{1}] ERROR: Unrecognized message type '{2}'", _txn_count, type.str ()));
 
       throw 500;
     }
 
+    compress_response (in, out);
     output = out.serialize ();
 
     // Record response time.
@@ -220,13 +390,92 @@ void Daemon::handler (const std::string& input, std::string& output)
   _bytes_out += output.length ();
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// A request carrying 'compression: deflate' has a zlib-compressed payload,
+// which is inflated in place, subject to the same request.limit.
+void Daemon::decompress_request (MsgView& in)
+{
+  auto method = in.get ("compression");
+  if (method == "")
+    return;
+
+  if (method != "deflate")
+    throw 401;
+
+  Timer timer;
+  timer.start ();
+
+  auto packed = in.getPayload ();
+  std::string payload;
+  if (! decompressPayload (packed, payload, (size_t) _config.getInteger ("request.limit")))
+  {
+#ifdef HAVE_LIBZ
+    throw 400;
+#else
+    throw 401;
+#endif
+  }
+
+  timer.stop ();
+  _pack_time    += timer.total_s ();
+  _raw_bytes    += payload.length ();
+  _packed_bytes += packed.length ();
+  ++_compressed;
+
+  if (in.get ("protocol") != "v2" &&
+      ! validUTF8 (payload.data (), payload.length ()))
+    throw 401;
+
+  in.setPayload (std::move (payload));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// A client that sends 'accept-compression: deflate' receives a compressed
+// payload whenever it is at least compression.threshold bytes.  A threshold of
+// zero disables response compression.
+void Daemon::compress_response (const MsgView& in, Msg& out)
+{
+  auto accepted = split (in.get ("accept-compression").str (), ',');
+  if (std::find_if (accepted.begin (), accepted.end (),
+                    [](const std::string& method) { return trim (method) == "deflate"; }) == accepted.end ())
+    return;
+
+  auto threshold = _config.get ("compression.threshold") == ""
+                     ? 1024
+                     : _config.getInteger ("compression.threshold");
+
+  auto payload = out.getPayload ();
+  if (threshold <= 0 ||
+      payload.length () < (size_t) threshold)
+    return;
+
+  Timer timer;
+  timer.start ();
+
+  std::string packed;
+  if (! compressPayload (payload, packed) ||
+      packed.length () >= payload.length ())
+    return;
+
+  timer.stop ();
+  _pack_time    += timer.total_s ();
+  _raw_bytes    += payload.length ();
+  _packed_bytes += packed.length ();
+  ++_compressed;
+
+  out.set ("compression", "deflate");
+  out.setPayload (packed);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Statistics request from dev.
-void Daemon::handle_statistics (const Msg& in, Msg& out)
+void Daemon::handle_statistics (const MsgView& in, Msg& out)
 {
   if (! _db.authenticate (in, out))
     return;
 
+  charge (in.get ("org").str (), in.get ("user").str ());
+
   // Support only Taskserver protocol v1.
   taskd_requireHeader (in, "protocol", "v1");
 
@@ -274,6 +523,13 @@ void Daemon::handle_statistics (const Msg& in, Msg& out)
   out.set ("average response time",        average_resp_time);
   out.set ("maximum response time",        _max_time);
   out.set ("tps",                          tps);
+  out.set ("compressed payloads",    (int) _compressed);
+  out.set ("compression ratio",            _packed_bytes ? (double) _raw_bytes / _packed_bytes : 0.0);
+  out.set ("compression time",             _pack_time);
+  {
+    std::lock_guard <std::mutex> lock (_admission_mutex);
+    out.set ("refused",              (int) _refused_count);
+  }
   out.set ("organizations",          (int) total_orgs);
   out.set ("users",                  (int) total_users);
   out.set ("user data",              (int) total_bytes);
@@ -284,19 +540,25 @@ void Daemon::handle_statistics (const Msg& in, Msg& out)
 
 ////////////////////////////////////////////////////////////////////////////////
 // Sync request.
-void Daemon::handle_sync (const Msg& in, Msg& out)
+void Daemon::handle_sync (const MsgView& in, Msg& out)
 {
   if (! _db.authenticate (in, out))
     return;
 
-  // Support only Taskserver protocol v1.
-  taskd_requireHeader (in, "protocol", "v1");
+  charge (in.get ("org").str (), in.get ("user").str ());
+
+  // Taskserver protocol v1 separates payload records with newlines, and v2
+  // frames them with a length prefix.
+  auto framed = in.get ("protocol") == "v2";
+  if (! framed)
+    taskd_requireHeader (in, "protocol", "v1");
 
   // Note: org/user already validated during authentication.
-  auto org      = in.get ("org");
-  auto user     = in.get ("user");
-  auto password = in.get ("key");
+  auto org      = in.get ("org").str ();
+  auto user     = in.get ("user").str ();
+  auto password = in.get ("key").str ();
   auto subtype  = in.get ("subtype");
+  auto delta    = in.get ("delta") == "on";
 
   if (_log)
     _log->write (format ("[{1}] 'sync{2}' from '{3}/{4}' using '{5}' at {6}:{7}",
@@ -304,7 +566,7 @@ void Daemon::handle_sync (const Msg& in, Msg& out)
                          (subtype == "init" ? "+init" : ""),
                          org,
                          user,
-                         in.get ("client"),
+                         in.get ("client").str (),
                          _client_address,
                          _client_port));
 
@@ -312,46 +574,76 @@ void Daemon::handle_sync (const Msg& in, Msg& out)
   if (_db.redirect (org, out))
     return;
 
-  // Separate payload into client_data and sync_key.
-  std::vector <std::string> client_data;               // Incoming client data.
+  // Another worker process may be syncing the same user.  The lock is held from
+  // loading the data until the new data is appended, and released when 'lock'
+  // is destroyed.
+  File lock (format ("{1}/orgs/{2}/users/{3}/tx.lock", _config.get ("root"), org, password));
+  if (! lock.exists ())
+    lock.create (0600);
+
+  if (! lock.open () ||
+      ! lock.lock ())
+    throw format ("ERROR: Could not lock '{1}': {2}", lock._data, strerror (errno));
+
+  // The containers of this request are allocated together, and released
+  // together on return.
+  Arena arena;
+
+  // Separate payload into client_data and sync_key.  The client data refers
+  // into the request buffer.
+  auto request = in.getPayload ();
+  ArenaVector <StringView> client_data {arena};        // Incoming client data.
   std::string sync_key;                                // Incoming client key.
-  parse_payload (in.getPayload (), client_data, sync_key);
+  phase ("parse_payload", true);
+  parse_payload (request, framed, client_data, sync_key);
+  phase ("parse_payload", false);
 
   // Load all user data.
-  std::vector <std::string> server_data;               // Data loaded on server.
+  TxData server_data;                                  // Data loaded on server.
+  phase ("load_server_data", true);
   load_server_data (org, password, server_data);
+  phase ("load_server_data", false);
 
-  std::vector <std::string> new_server_data;           // New tasks for tx.data.
-  std::vector <std::string> new_client_data;           // New tasks for client.
+  ArenaVector <std::string> new_server_data {arena};   // New tasks for tx.data.
+  ArenaVector <std::string> new_client_data {arena};   // New tasks for client.
+  ArenaVector <Task> client_seen {arena};              // Client's last version.
 
   // Find branch point and extract subset.
+  phase ("find_branch_point", true);
   unsigned int branch_point = find_branch_point (server_data, sync_key);
-  std::vector <Task> server_subset;
+  phase ("find_branch_point", false);
+
+  ArenaVector <Task> server_subset {arena};
+  phase ("extract_subset", true);
   extract_subset (server_data, branch_point, server_subset);
+  phase ("extract_subset", false);
 
-  // Maintain a list of already-merged task UUIDs.
-  std::vector <std::string> already_seen;
+  UUIDSet subset_uuids (arena);
+  for (auto& task : server_subset)
+    subset_uuids.insert (task.get ("uuid"));
+
+  // Maintain a set of already-merged task UUIDs.
+  UUIDSet already_seen (arena);
   int store_count = 0;
   int merge_count = 0;
 
   // For each incoming task...
+  phase ("merge", true);
   for (auto& client_task : client_data)
   {
     // Validate task.
-    Task task (client_task);
+    Task task (client_task.str ());
     std::string uuid = task.get ("uuid");
     task.validate ();
 
     // If task is in subset
-    if (contains (server_subset, uuid))
+    if (subset_uuids.contains (uuid))
     {
       // Merging a task causes a complete scan, and that picks up all mods to
       // that same task.  Therefore, there is no need to re-process a UUID.
-      if (std::find (already_seen.begin (), already_seen.end (), uuid) != already_seen.end ())
+      if (! already_seen.insert (uuid))
         continue;
 
-      already_seen.push_back (uuid);
-
       // Find common ancestor, prior to branch point
       unsigned int common_ancestor = find_common_ancestor (server_data,
                                                            branch_point,
@@ -366,23 +658,26 @@ void Daemon::handle_sync (const Msg& in, Msg& out)
       get_server_mods (server_mods, server_data, uuid, common_ancestor);
 
       // Merge sort between client_mods and server_mods, patching ancestor.
-      Task combined (server_data[common_ancestor]);
+      Task combined (server_data[common_ancestor].str ());
       merge_sort (client_mods, server_mods, combined);
       std::string combined_JSON = combined.composeJSON ();
 
       // Append combined task to client and server data, if not already there.
       new_server_data.push_back (combined_JSON + "\n");
       new_client_data.push_back (combined_JSON);
+      if (delta)
+        client_seen.push_back (client_mods.back ());
       ++merge_count;
     }
     else
     {
       // Task not in subset, therefore can be stored unmodified.  Does not get
       // returned to client.
-      new_server_data.push_back (client_task + "\n");
+      new_server_data.push_back (client_task.str () + "\n");
       ++store_count;
     }
   }
+  phase ("merge", false);
 
   _log->write (format ("[{1}] Stored {2} tasks, merged {3} tasks",
                        _txn_count,
@@ -399,15 +694,16 @@ void Daemon::handle_sync (const Msg& in, Msg& out)
     _log->write (format ("[{1}] New sync key '{2}'", _txn_count, new_sync_key));
 
     // Append new_server_data to file.
+    phase ("append", true);
     append_server_data (org, password, new_server_data);
+    phase ("append", false);
   }
   else
   {
-    std::vector <std::string>::reverse_iterator i;
-    for (i = server_data.rbegin (); i != server_data.rend (); ++i)
-      if ((*i)[0] != '{')
+    for (auto i = server_data.size (); i > 0; --i)
+      if (server_data[i - 1][0] != '{')
       {
-        new_sync_key = *i;
+        new_sync_key = server_data[i - 1].str ();
         break;
       }
 
@@ -419,17 +715,39 @@ void Daemon::handle_sync (const Msg& in, Msg& out)
   if (server_subset.size () ||
       new_client_data.size ())
   {
-    payload = generate_payload (server_subset,
-                                new_client_data,
-                                new_sync_key);
+    phase ("generate_payload", true);
+    if (delta)
+      payload = generate_delta_payload (server_data,
+                                        branch_point,
+                                        server_subset,
+                                        new_client_data,
+                                        client_seen,
+                                        new_sync_key,
+                                        framed);
+    else
+      payload = generate_payload (server_subset,
+                                  new_client_data,
+                                  new_sync_key,
+                                  framed);
+    phase ("generate_payload", false);
   }
 
   // No outgoing data, just sent the latest key.
+  else if (framed)
+  {
+    appendRecord (payload, new_sync_key);
+  }
   else
   {
     payload = new_sync_key + "\n";
   }
 
+  if (framed)
+    out.set ("protocol", "v2");
+
+  if (delta)
+    out.set ("delta", "on");
+
   out.setPayload (payload);
 
   // If there are changes, respond with 200, otherwise 201.
@@ -450,23 +768,42 @@ void Daemon::handle_sync (const Msg& in, Msg& out)
 
 ////////////////////////////////////////////////////////////////////////////////
 void Daemon::parse_payload (
-  const std::string& payload,
-  std::vector <std::string>& data,
+  const StringView& payload,
+  bool framed,
+  ArenaVector <StringView>& data,
   std::string& sync_key) const
 {
-  // Break payload into lines.
-  auto lines = split (payload, '\n');
-
-  // Separate into data and key.
+  // Break payload into records, which are lines unless framed, and separate
+  // into data and key.  The records are views into the payload.
   // TODO Some syntax checking would be nice.
-  for (auto& i : lines)
+  StringView record;
+  size_t offset = 0;
+  while (offset < payload.size ())
   {
-    if (i != "")
+    if (framed)
     {
-      if (i[0] == '{')
-        data.push_back (i);
+      if (! nextRecord (payload, offset, record))
+        break;
+
+      if (! validUTF8 (record.data (), record.size ()))
+        throw 401;
+    }
+    else
+    {
+      auto newline = payload.find ('\n', offset);
+      if (newline == StringView::npos)
+        newline = payload.size ();
+
+      record = payload.substr (offset, newline - offset);
+      offset = newline + 1;
+    }
+
+    if (! record.empty ())
+    {
+      if (record[0] == '{')
+        data.push_back (record);
       else
-        sync_key = i;
+        sync_key = record.str ();
     }
   }
 
@@ -480,7 +817,7 @@ void Daemon::parse_payload (
 void Daemon::load_server_data (
   const std::string& org,
   const std::string& password,
-  std::vector <std::string>& data) const
+  TxData& data) const
 {
   Directory user_dir (_config.get ("root"));
   user_dir += "orgs";
@@ -490,7 +827,15 @@ void Daemon::load_server_data (
   File user_data (user_dir._data + "/tx.data");
 
   if (user_data.exists ())
-    user_data.read (data);
+  {
+    if (! data.open (user_data._data))
+      throw format ("ERROR: Could not read '{1}': {2}", user_data._data, strerror (errno));
+
+    // A final line without a newline was torn by a crash during an append, and
+    // is ignored.  The next append truncates it.
+    if (data.torn ())
+      _log->write (format ("[{1}] Ignored partial record in {2}", _txn_count, user_data._data));
+  }
   else
     user_data.create (0600);
 
@@ -501,32 +846,66 @@ void Daemon::load_server_data (
 void Daemon::append_server_data (
   const std::string& org,
   const std::string& password,
-  const std::vector <std::string>& data) const
+  const ArenaVector <std::string>& data) const
 {
+  // The durability setting determines how much survives a crash:
+  //   none  the OS flushes data whenever it chooses
+  //   data  the appended data is flushed before the sync is acknowledged
+  //   full  all file metadata is flushed too, and the directory of a new file
+  auto durability = _config.get ("durability");
+  if (durability == "")
+    durability = "full";
+  else if (durability != "none" && durability != "data" && durability != "full")
+    throw format ("ERROR: Unrecognized durability '{1}'", durability);
+
   Directory user_dir (_config.get ("root"));
   user_dir += "orgs";
   user_dir += org;
   user_dir += "users";
   user_dir += password;
 
-  // Write to a tmp copy of the data, then renamed afterwards. This guarantees
-  // that there are no partial writes to the real data file, which may occur
-  // in situations where there is no disk space.
-  File user_data     (user_dir._data     + "/tx.data");
-  File user_tmp_data (user_dir._data + "/tx.tmp.data");
+  // Append in place, rather than rewriting the whole history.  A failed write,
+  // for example when there is no disk space, is truncated back to the original
+  // length, so that there are no partial writes to the data file.  A partial
+  // line left by an earlier crash is truncated first.
+  File user_data (user_dir._data + "/tx.data");
+  bool created = ! user_data.exists ();
 
-  // Create or copy, as necessary.
-  if (user_data.exists ())
-    File::copy (user_data._data, user_tmp_data._data);
-  else
-    user_tmp_data.create (0600);
+  // Read access is needed to find the last complete line.
+  int fd = open (user_data._data.c_str (), O_RDWR | O_CREAT | O_APPEND, 0600);
+  if (fd == -1)
+    throw format ("ERROR: Could not open '{1}': {2}", user_data._data, strerror (errno));
 
-  // Store the data in the temporary file.
-  user_tmp_data.append (data);
+  std::string buffer;
+  for (auto& line : data)
+    buffer += line;
+
+  struct stat st;
+  off_t length = -1;
+  if (fstat (fd, &st) == 0)
+    length = completeLength (fd, st.st_size);
 
-  // Move the temp file to the real file, after closing it.
-  user_tmp_data.close ();
-  File::move (user_tmp_data._data, user_data._data);
+  if (length == -1 ||
+      (length < st.st_size && ftruncate (fd, length) == -1) ||
+      ! writeAll (fd, buffer) ||
+      (durability != "none" && ! syncDescriptor (fd, durability == "data")))
+  {
+    int error = errno;
+    if (length != -1 &&
+        ftruncate (fd, length) == 0)
+      syncDescriptor (fd, true);
+
+    close (fd);
+    throw format ("ERROR: Could not write '{1}': {2}", user_data._data, strerror (error));
+  }
+
+  close (fd);
+
+  // A new file is only reachable once its directory entry is flushed.
+  if (created &&
+      durability == "full" &&
+      ! syncFile (user_dir._data, false))
+    throw format ("ERROR: Could not sync '{1}': {2}", user_dir._data, strerror (errno));
 
   _log->write (format ("[{1}] Wrote {2}", _txn_count, data.size ()));
 }
@@ -535,7 +914,7 @@ void Daemon::append_server_data (
 // Note: A missing sync_key implies first-time sync, which means the earliest
 //       possible branch point is used.
 unsigned int Daemon::find_branch_point (
-  const std::vector <std::string>& data,
+  const TxData& data,
   const std::string& sync_key) const
 {
   unsigned int branch = 0;
@@ -545,15 +924,13 @@ unsigned int Daemon::find_branch_point (
     return branch;
 
   bool found = false;
-  for (auto& i : data)
+  for (; branch < data.size (); ++branch)
   {
-    if (i == sync_key)
+    if (data[branch] == sync_key)
     {
       found = true;
       break;
     }
-    else
-      ++branch;
   }
 
   if (! found)
@@ -565,9 +942,9 @@ unsigned int Daemon::find_branch_point (
 
 ////////////////////////////////////////////////////////////////////////////////
 void Daemon::extract_subset (
-  const std::vector <std::string>& data,
+  const TxData& data,
   const unsigned int branch_point,
-  std::vector <Task>& subset) const
+  ArenaVector <Task>& subset) const
 {
   unsigned int i;
 
@@ -576,7 +953,7 @@ void Daemon::extract_subset (
     if (branch_point < data.size ())
       for (i = branch_point; i < data.size (); ++i)
         if (data[i][0] == '{')
-          subset.push_back (Task (data[i]));
+          subset.push_back (Task (data[i].str ()));
   }
 
   catch (const std::string& e)
@@ -587,26 +964,28 @@ void Daemon::extract_subset (
   _log->write (format ("[{1}] Subset {2} tasks", _txn_count, subset.size ()));
 }
 
-////////////////////////////////////////////////////////////////////////////////
-bool Daemon::contains (
-  const std::vector <Task>& subset,
-  const std::string& uuid) const
-{
-  for (auto& i : subset)
-    if (uuid == i.get ("uuid"))
-      return true;
-
-  return false;
-}
 
 ////////////////////////////////////////////////////////////////////////////////
 std::string Daemon::generate_payload (
-  const std::vector <Task>& subset,
-  const std::vector <std::string>& additions,
-  const std::string& key) const
+  const ArenaVector <Task>& subset,
+  const ArenaVector <std::string>& additions,
+  const std::string& key,
+  bool framed) const
 {
   std::string payload;
 
+  if (framed)
+  {
+    for (auto& s : subset)
+      appendRecord (payload, s.composeJSON ());
+
+    for (auto& a : additions)
+      appendRecord (payload, a);
+
+    appendRecord (payload, key);
+    return payload;
+  }
+
   for (auto& s : subset)
     payload += s.composeJSON () + "\n";
 
@@ -618,11 +997,185 @@ std::string Daemon::generate_payload (
   return payload;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Like generate_payload, but each task is sent as a delta against the version
+// the client last saw, if there is one.  For subset tasks, that is the previous
+// version of the task on the server, and for merged tasks, that is the last
+// version the client sent.  Subset deltas are applied in order by the client.
+//
+// A merged task is sent only as its merged delta.  That delta is against the
+// client's own version, and so subset deltas applied before it would leave the
+// client with a base the merged delta was not computed against.
+std::string Daemon::generate_delta_payload (
+  const TxData& data,
+  unsigned int branch_point,
+  const ArenaVector <Task>& subset,
+  const ArenaVector <std::string>& additions,
+  const ArenaVector <Task>& seen,
+  const std::string& key,
+  bool framed) const
+{
+  std::unordered_set <std::string> merged;
+  for (auto& s : seen)
+    merged.insert (s.get ("uuid"));
+
+  std::map <std::string, Task> versions;
+  get_prior_versions (data, branch_point, subset, versions);
+
+  std::vector <std::string> records;
+  for (auto& s : subset)
+  {
+    auto uuid = s.get ("uuid");
+    if (merged.find (uuid) != merged.end ())
+      continue;
+
+    auto prior = versions.find (uuid);
+    if (prior != versions.end ())
+    {
+      records.push_back (compose_delta (prior->second, s));
+      prior->second = s;
+    }
+    else
+    {
+      records.push_back (s.composeJSON ());
+      versions[uuid] = s;
+    }
+  }
+
+  for (unsigned int i = 0; i < additions.size (); ++i)
+    records.push_back (compose_delta (seen[i], Task (additions[i])));
+
+  records.push_back (key);
+
+  std::string payload;
+  for (auto& record : records)
+  {
+    if (framed)
+      appendRecord (payload, record);
+    else
+      payload += record + "\n";
+  }
+
+  return payload;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Reads the UUID of a task line without parsing the task.  Inside a JSON
+// string the quotes are escaped, so '"uuid":"' can only be the key.  A line
+// formatted differently is parsed.
+static std::string line_uuid (const StringView& line)
+{
+  static const StringView key ("\"uuid\":\"");
+
+  auto start = line.find (key);
+  if (start != StringView::npos)
+  {
+    start += key.length ();
+    auto end = line.find ('"', start);
+    if (end != StringView::npos)
+      return line.substr (start, end - start).str ();
+  }
+
+  return Task (line.str ()).get ("uuid");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Finds the last version, prior to the branch point, of every task in the
+// subset, in one backwards pass that stops once all are found.  Only those
+// versions are parsed.
+void Daemon::get_prior_versions (
+  const TxData& data,
+  unsigned int branch_point,
+  const ArenaVector <Task>& subset,
+  std::map <std::string, Task>& versions) const
+{
+  std::unordered_set <std::string> wanted;
+  for (auto& task : subset)
+    wanted.insert (task.get ("uuid"));
+
+  for (size_t i = std::min ((size_t) branch_point, data.size ());
+       i > 0 && versions.size () < wanted.size ();
+       --i)
+  {
+    auto line = data[i - 1];
+    if (line[0] != '{')
+      continue;
+
+    auto uuid = line_uuid (line);
+    if (wanted.find (uuid) != wanted.end () &&
+        versions.find (uuid) == versions.end ())
+      versions[uuid] = Task (line.str ());
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Composes a delta record that transforms from into to:
+//
+//   {"uuid":"...","delta":{<changed attributes>},"remove":["<attribute>",...]}
+//
+// Annotations are serialized as one array, so if any annotation differs, the
+// whole set is sent, or "annotations" is removed.
+std::string Daemon::compose_delta (const Task& from, const Task& to) const
+{
+  std::vector <std::string> removed;
+  std::vector <std::string> added;
+  std::vector <std::string> modified;
+  diff (from, to, removed, added, modified);
+
+  added.insert (added.end (), modified.begin (), modified.end ());
+
+  Task changes;
+  std::vector <std::string> remove;
+  bool annotations = false;
+
+  for (auto& att : added)
+  {
+    if (! att.compare (0, 11, "annotation_", 11))
+      annotations = true;
+    else if (to.get (att) == "")
+      remove.push_back (att);
+    else
+      changes.data[att] = to.get (att);
+  }
+
+  for (auto& att : removed)
+  {
+    if (! att.compare (0, 11, "annotation_", 11))
+      annotations = true;
+    else
+      remove.push_back (att);
+  }
+
+  if (annotations)
+  {
+    for (auto& att : to.data)
+      if (! att.first.str ().compare (0, 11, "annotation_", 11))
+        changes.data[att.first] = att.second;
+
+    if (to.getAnnotationCount () == 0)
+      remove.push_back ("annotations");
+  }
+
+  std::string record = "{\"uuid\":\"" + json::encode (to.get ("uuid"))
+                     + "\",\"delta\":" + changes.composeJSON ()
+                     + ",\"remove\":[";
+
+  for (unsigned int i = 0; i < remove.size (); ++i)
+  {
+    if (i)
+      record += ',';
+
+    record += '"' + json::encode (remove[i]) + '"';
+  }
+
+  return record + "]}";
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Starting at branch_point and working backwards, find the first instance of a
 // task matching uuid.
 unsigned int Daemon::find_common_ancestor (
-  const std::vector <std::string>& data,
+  const TxData& data,
   unsigned int branch_point,
   const std::string& uuid) const
 {
@@ -630,7 +1183,7 @@ unsigned int Daemon::find_common_ancestor (
   {
     if (data[i][0] == '{')
     {
-      Task t (data[i]);
+      Task t (data[i].str ());
       if (t.get ("uuid") == uuid)
         return (unsigned int) i;
     }
@@ -644,14 +1197,14 @@ unsigned int Daemon::find_common_ancestor (
 // sequence.
 void Daemon::get_client_mods (
   std::vector <Task>& mods,
-  const std::vector <std::string>& data,
+  const ArenaVector <StringView>& data,
   const std::string& uuid) const
 {
   for (auto& line : data)
   {
     if (line[0] == '{')
     {
-      Task t (line);
+      Task t (line.str ());
       if (t.get ("uuid") == uuid)
         mods.push_back (t);
     }
@@ -663,7 +1216,7 @@ void Daemon::get_client_mods (
 // sequence.
 void Daemon::get_server_mods (
   std::vector <Task>& mods,
-  const std::vector <std::string>& data,
+  const TxData& data,
   const std::string& uuid,
   unsigned int ancestor) const
 {
@@ -671,7 +1224,7 @@ void Daemon::get_server_mods (
   {
     if (data[i][0] == '{')
     {
-      Task t (data[i]);
+      Task t (data[i].str ());
       if (t.get ("uuid") == uuid)
         mods.push_back (t);
     }
@@ -757,28 +1310,16 @@ void Daemon::patch (
   const Task& from,
   const Task& to) const
 {
-  // Determine the different attribute names between from and to.
-  std::vector <std::string> from_atts;
-  for (auto& att: from.data)
-    from_atts.push_back (att.first);
-
-  std::vector <std::string> to_atts;
-  for (auto& att: to.data)
-    to_atts.push_back (att.first);
-
   std::vector <std::string> from_only;
   std::vector <std::string> to_only;
-  listDiff (from_atts, to_atts, from_only, to_only);
-
-  std::vector <std::string> common_atts;
-  listIntersect (from_atts, to_atts, common_atts);
+  std::vector <std::string> modified;
+  diff (from, to, from_only, to_only, modified);
 
   // The from-only attributes must be deleted from base.
-  std::vector <std::string>::iterator i;
-  for (i = from_only.begin (); i != from_only.end (); ++i)
+  for (auto& i : from_only)
   {
-    _log->write (format ("[{1}] patch remove {2}", _txn_count, *i));
-    base.remove (*i);
+    _log->write (format ("[{1}] patch remove {2}", _txn_count, i));
+    base.remove (i);
   }
 
   // The to-only attributes must be added to base.
@@ -789,16 +1330,53 @@ void Daemon::patch (
   }
 
   // The intersecting attributes, if the values differ, are applied.
-  for (auto& i : common_atts)
+  for (auto& i : modified)
   {
-    if (from.get (i) != to.get (i))
-    {
-      _log->write (format ("[{1}] patch modify {2}={3}", _txn_count, i, to.get (i)));
-      base.set (i, to.get (i));
-    }
+    _log->write (format ("[{1}] patch modify {2}={3}", _txn_count, i, to.get (i)));
+    base.set (i, to.get (i));
   }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Determines the attributes only in from, only in to, and those in both with
+// differing values.
+void Daemon::diff (
+  const Task& from,
+  const Task& to,
+  std::vector <std::string>& from_only,
+  std::vector <std::string>& to_only,
+  std::vector <std::string>& modified) const
+{
+  std::vector <std::string> from_atts;
+  for (auto& att: from.data)
+    from_atts.push_back (att.first);
+
+  std::vector <std::string> to_atts;
+  for (auto& att: to.data)
+    to_atts.push_back (att.first);
+
+  listDiff (from_atts, to_atts, from_only, to_only);
+
+  std::vector <std::string> common_atts;
+  listIntersect (from_atts, to_atts, common_atts);
+
+  for (auto& i : common_atts)
+    if (from.get (i) != to.get (i))
+      modified.push_back (i);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Notifies the optional phase hook, so that the cost of each stage of a sync
+// can be measured without a network in the way.  Names are literals, so that
+// a sync without a hook pays nothing to name its phases.
+void Daemon::phase (const char* name, bool entry) const
+{
+  if (! _phase)
+    return;
+
+  (*_phase) (name, entry);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Scans root, counts entities and sums data size.
 void Daemon::get_totals (
@@ -894,6 +1472,13 @@ void command_server (Database& db)
     server.setPort       (port);
     server.setFamily     (family);
     server.setQueueSize  (db._config->getInteger ("queue.size"));
+    if (db._config->getInteger ("processes") > 1)
+      server.setProcesses (db._config->getInteger ("processes"));
+    if (db._config->getInteger ("pool.size") > 0)
+      server.setPoolSize (db._config->getInteger ("pool.size"));
+    if (db._config->get ("lane.threshold") != "")
+      server.setLaneThreshold (db._config->getInteger ("lane.threshold"));
+
     server.setLimit      (db._config->getInteger ("request.limit"));
     server.setLogClients (db._config->getBoolean ("ip.log"));
 
@@ -48,6 +48,10 @@
 #include <gnutls/gnutls.h>
 #endif
 
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
+
 ////////////////////////////////////////////////////////////////////////////////
 void command_diag (Database& config)
 {
@@ -135,6 +139,14 @@ void command_diag (Database& config)
 #elif defined LIBGNUTLS_VERSION
             << LIBGNUTLS_VERSION
 #endif
+#else
+            << "n/a"
+#endif
+            << '\n';
+
+  std::cout << "        zlib: "
+#ifdef HAVE_LIBZ
+            << ZLIB_VERSION
 #else
             << "n/a"
 #endif
@@ -92,8 +92,10 @@ void command_help (const std::vector <std::string>& args)
                 << "  --data <root>  Data directory, otherwise $TASKDDATA\n"
                 << "  --NAME=VALUE   Temporary configuration override\n"
                 << '\n'
-                << "Note that sending the HUP signal to the taskd server causes a configuration\n"
-                << "file reload before the next request is handled.\n"
+                << "Note that sending the USR1 signal to the taskd server causes a configuration\n"
+                << "file reload before the next request is handled.  The HUP signal stops the\n"
+                << "server once accepted requests are handled, and USR2 hands the listening\n"
+                << "socket to a newly started server, then stops.\n"
                 << '\n';
     }
 #ifdef FEATURE_API_INTERFACE
@@ -177,6 +179,23 @@ void command_help (const std::vector <std::string>& args)
                 << "  --NAME=VALUE   Temporary configuration override\n"
                 << '\n';
     }
+    else if (closeEnough ("import", args[1], 3))
+    {
+      std::cout << '\n'
+                << "taskd import [options] users <file>\n"
+                << '\n'
+                << "Creates many users at once.  Each line of <file> is '<org>,<user-name>' or\n"
+                << "'<org><TAB><user-name>'.  Missing organizations are created.  For each new\n"
+                << "user, writes '<org><TAB><user-name><TAB><uuid>' to standard output.\n"
+                << '\n'
+                << "Options:\n"
+                << "  --quiet        Turns off verbose output\n"
+                << "  --debug        Generates debugging diagnostics\n"
+                << "  --data <root>  Data directory, otherwise $TASKDDATA\n"
+                << "  --jobs=N       Provision up to N organizations in parallel\n"
+                << "  --NAME=VALUE   Temporary configuration override\n"
+                << '\n';
+    }
     else if (closeEnough ("diag", args[1], 3))
     {
       std::cout << '\n'
@@ -216,6 +235,7 @@ void command_help (const std::vector <std::string>& args)
               << "       taskd remove  [options] user <org> <uuid>\n"
               << "       taskd suspend [options] user <org> <uuid>\n"
               << "       taskd resume  [options] user <org> <uuid>\n"
+              << "       taskd import  [options] users <file>\n"
               << '\n'
               << "       taskd config  [options] [--force] [<name> [<value>]]\n"
               << "       taskd init    [options]\n"
@@ -32,6 +32,7 @@
 #include <string>
 #include <ConfigFile.h>
 #include <Msg.h>
+#include <MsgView.h>
 #include <Log.h>
 #include <FS.h>
 #include <Database.h>
@@ -46,6 +47,7 @@ void command_add      (Database&, const std::vector <std::string>&);
 void command_remove   (Database&, const std::vector <std::string>&);
 void command_suspend  (Database&, const std::vector <std::string>&);
 void command_resume   (Database&, const std::vector <std::string>&);
+void command_import   (Database&, const std::vector <std::string>&);
 void command_api      (Database&, const std::vector <std::string>&);
 void command_validate (           const std::vector <std::string>&);
 
@@ -54,6 +56,7 @@ bool taskd_applyOverride (Config&, const std::string&);
 void taskd_requireSetting (Config&, const std::string&);
 void taskd_requireVersion (const Msg&, const std::string&);
 void taskd_requireHeader (const Msg&, const std::string&, const std::string&);
+void taskd_requireHeader (const MsgView&, const std::string&, const std::string&);
 bool taskd_at_least (const std::string&, const std::string&);
 bool taskd_createDirectory (Directory&, bool);
 
@@ -63,6 +66,10 @@ void taskd_renderMap (const std::map <std::string, std::string>&, const std::str
 bool taskd_is_org      (const Directory&, const std::string&);
 bool taskd_is_user     (const Directory&root, const std::string&, const std::string&);
 bool taskd_is_user_key (const Directory&root, const std::string&, const std::string&);
+void taskd_lock_user_index (const Directory&, const std::string&, File&);
+void taskd_read_user_index (const Directory&, const std::string&, std::map <std::string, std::string>&);
+void taskd_load_user_index (const Directory&, const std::string&, std::map <std::string, std::string>&);
+bool taskd_save_user_index (const Directory&, const std::string&, const std::map <std::string, std::string>&);
 
 std::string taskd_error (const int);
 
@@ -35,9 +35,20 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 #include <util.h>
 #include <format.h>
 #include <shared.h>
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 // Handle the generation of UUIDs on FreeBSD in a separate implementation
 // of the uuid () function, since the API is quite different from Linux's.
@@ -107,4 +118,519 @@ time_t timegm (struct tm *tm)
 #endif
 
 ////////////////////////////////////////////////////////////////////////////////
+// Deflates input into output, using the zlib format.  Returns false if zlib
+// is not available, or compression failed.
+bool compressPayload (const std::string& input, std::string& output)
+{
+#ifdef HAVE_LIBZ
+  uLongf size = compressBound (input.length ());
+  output.resize (size);
+  if (compress2 ((Bytef*) &output[0], &size,
+                 (const Bytef*) input.data (), input.length (),
+                 Z_DEFAULT_COMPRESSION) != Z_OK)
+    return false;
+
+  output.resize (size);
+  return true;
+#else
+  (void) input;
+  (void) output;
+  return false;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Inflates zlib-format input into output.  Any trailing bytes after the end of
+// the compressed stream are ignored, which accommodates the newline that
+// Msg::serialize appends to the payload.  A non-zero limit caps the inflated
+// size, which guards against decompression bombs.  Returns false if zlib is
+// not available, the data is corrupt, or the limit is exceeded.
+bool decompressPayload (
+  const StringView& input,
+  std::string& output,
+  size_t limit)
+{
+#ifdef HAVE_LIBZ
+  z_stream stream {};
+  if (inflateInit (&stream) != Z_OK)
+    return false;
+
+  stream.next_in  = (Bytef*) input.data ();
+  stream.avail_in = input.length ();
+
+  output.clear ();
+  char buffer[16384];
+  int status;
+  do
+  {
+    stream.next_out  = (Bytef*) buffer;
+    stream.avail_out = sizeof (buffer);
+
+    status = inflate (&stream, Z_NO_FLUSH);
+    if (status != Z_OK && status != Z_STREAM_END)
+      break;
+
+    output.append (buffer, sizeof (buffer) - stream.avail_out);
+    if (limit && output.length () > limit)
+    {
+      status = Z_BUF_ERROR;
+      break;
+    }
+  }
+  while (status != Z_STREAM_END);
+
+  inflateEnd (&stream);
+  return status == Z_STREAM_END;
+#else
+  (void) input;
+  (void) output;
+  (void) limit;
+  return false;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Protocol v2 frames each payload record with a 4-byte, big-endian length.
+void appendRecord (std::string& payload, const std::string& record)
+{
+  uint32_t length = record.length ();
+  payload += (char) ((length >> 24) & 0xFF);
+  payload += (char) ((length >> 16) & 0xFF);
+  payload += (char) ((length >>  8) & 0xFF);
+  payload += (char) ( length        & 0xFF);
+  payload += record;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Extracts the record at offset, and advances offset past it.  Returns false
+// at the end of the payload, where a single trailing newline, as appended by
+// Msg::serialize, is tolerated.  Throws on a truncated record.
+bool nextRecord (
+  const StringView& payload,
+  size_t& offset,
+  StringView& record)
+{
+  auto remaining = payload.length () - offset;
+  if (remaining == 0 ||
+      (remaining == 1 && payload[offset] == '\n'))
+    return false;
+
+  if (remaining < 4)
+    throw std::string ("ERROR: Truncated record length");
+
+  auto bytes = (const unsigned char*) payload.data () + offset;
+  uint32_t length = ((uint32_t) bytes[0] << 24) |
+                    ((uint32_t) bytes[1] << 16) |
+                    ((uint32_t) bytes[2] <<  8) |
+                     (uint32_t) bytes[3];
+
+  if (length > remaining - 4)
+    throw std::string ("ERROR: Truncated record");
+
+  record = payload.substr (offset + 4, length);
+  offset += 4 + length;
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Flushes a file, or a directory, to stable storage.  With data_only, only the
+// data and the metadata needed to read it back are flushed, which is cheaper.
+// Returns false on failure, with errno set.
+bool syncFile (const std::string& path, bool data_only)
+{
+  int fd = open (path.c_str (), O_RDONLY);
+  if (fd == -1)
+    return false;
 
+  bool status = syncDescriptor (fd, data_only);
+
+  int error = errno;
+  close (fd);
+  errno = error;
+  return status;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool syncDescriptor (int fd, bool data_only)
+{
+#if defined(DARWIN)
+  // fsync on Darwin does not flush the drive cache.
+  (void) data_only;
+  return fcntl (fd, F_FULLFSYNC) == 0;
+#elif defined(_POSIX_SYNCHRONIZED_IO) && _POSIX_SYNCHRONIZED_IO > 0
+  return (data_only ? fdatasync (fd) : fsync (fd)) == 0;
+#else
+  (void) data_only;
+  return fsync (fd) == 0;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Writes all of data, retrying short and interrupted writes.  Returns false on
+// failure, with errno set.
+bool writeAll (int fd, const std::string& data)
+{
+  const char* next = data.data ();
+  size_t remaining = data.length ();
+  while (remaining)
+  {
+    ssize_t written = write (fd, next, remaining);
+    if (written == -1)
+    {
+      if (errno == EINTR)
+        continue;
+
+      return false;
+    }
+
+    next      += written;
+    remaining -= written;
+  }
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Returns the length of the first size bytes of the file, up to and including
+// the last newline.  Anything beyond that is a partial line, torn by a crash
+// during an append.  Returns -1 on a read error.
+off_t completeLength (int fd, off_t size)
+{
+  char buffer[4096];
+  while (size > 0)
+  {
+    off_t start = size > (off_t) sizeof (buffer) ? size - (off_t) sizeof (buffer) : 0;
+    ssize_t bytes = pread (fd, buffer, size - start, start);
+    if (bytes == -1)
+    {
+      if (errno == EINTR)
+        continue;
+
+      return -1;
+    }
+
+    if (bytes < size - start)
+      return -1;
+
+    for (ssize_t i = bytes - 1; i >= 0; --i)
+      if (buffer[i] == '\n')
+        return start + i + 1;
+
+    size = start;
+  }
+
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Passes an open descriptor to the process at the other end of a Unix domain
+// socket, along with a single byte.  Returns false on failure, with errno set.
+bool sendDescriptor (int socket, int fd)
+{
+  char byte = 'F';
+  struct iovec iov {&byte, 1};
+
+  char control[CMSG_SPACE (sizeof (int))] {};
+  struct msghdr message {};
+  message.msg_iov        = &iov;
+  message.msg_iovlen     = 1;
+  message.msg_control    = control;
+  message.msg_controllen = sizeof (control);
+
+  struct cmsghdr* header = CMSG_FIRSTHDR (&message);
+  header->cmsg_level = SOL_SOCKET;
+  header->cmsg_type  = SCM_RIGHTS;
+  header->cmsg_len   = CMSG_LEN (sizeof (int));
+  memcpy (CMSG_DATA (header), &fd, sizeof (int));
+
+  ssize_t sent;
+  do
+  {
+    sent = sendmsg (socket, &message, 0);
+  }
+  while (sent == -1 && errno == EINTR);
+
+  return sent == 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Receives a descriptor sent by sendDescriptor.  Returns -1 on failure.
+int receiveDescriptor (int socket)
+{
+  char byte;
+  struct iovec iov {&byte, 1};
+
+  char control[CMSG_SPACE (sizeof (int))] {};
+  struct msghdr message {};
+  message.msg_iov        = &iov;
+  message.msg_iovlen     = 1;
+  message.msg_control    = control;
+  message.msg_controllen = sizeof (control);
+
+  ssize_t received;
+  do
+  {
+    received = recvmsg (socket, &message, 0);
+  }
+  while (received == -1 && errno == EINTR);
+
+  if (received != 1)
+    return -1;
+
+  struct cmsghdr* header = CMSG_FIRSTHDR (&message);
+  if (! header                          ||
+      header->cmsg_level != SOL_SOCKET  ||
+      header->cmsg_type  != SCM_RIGHTS  ||
+      header->cmsg_len   != CMSG_LEN (sizeof (int)))
+    return -1;
+
+  int fd;
+  memcpy (&fd, CMSG_DATA (header), sizeof (int));
+  return fd;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Days since 1970-01-01 of a proleptic Gregorian date, after Howard Hinnant's
+// days_from_civil.
+static long daysFromCivil (long y, unsigned m, unsigned d)
+{
+  y -= m <= 2;
+  const long era = y / 400;
+  const unsigned yoe = (unsigned) (y - era * 400);
+  const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + (long) doe - 719468;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// The inverse of daysFromCivil.
+static void civilFromDays (long z, long& y, unsigned& m, unsigned& d)
+{
+  z += 719468;
+  const long era = z / 146097;
+  const unsigned doe = (unsigned) (z - era * 146097);
+  const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  const unsigned mp = (5 * doy + 2) / 153;
+  d = doy - (153 * mp + 2) / 5 + 1;
+  m = mp < 10 ? mp + 3 : mp - 9;
+  y = (long) yoe + era * 400 + (m <= 2);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Converts the wire date format, YYYYMMDDTHHMMSSZ, to an epoch string, without
+// going through the general Datetime parser.  Returns false for anything else,
+// including out-of-range fields and dates before 1980, so that the caller can
+// fall back to Datetime.
+bool parseISO (const std::string& text, std::string& epoch)
+{
+  if (text.length () != 16 ||
+      text[8] != 'T'       ||
+      text[15] != 'Z')
+    return false;
+
+  unsigned digits[14];
+  for (int i = 0, j = 0; i < 15; ++i)
+  {
+    if (i == 8)
+      continue;
+
+    digits[j] = (unsigned) (text[i] - '0');
+    if (digits[j++] > 9)
+      return false;
+  }
+
+  long year       = digits[0] * 1000 + digits[1] * 100 + digits[2] * 10 + digits[3];
+  unsigned month  = digits[4]  * 10 + digits[5];
+  unsigned day    = digits[6]  * 10 + digits[7];
+  unsigned hour   = digits[8]  * 10 + digits[9];
+  unsigned minute = digits[10] * 10 + digits[11];
+  unsigned second = digits[12] * 10 + digits[13];
+
+  static const unsigned month_days[] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+  if (year < 1980               ||
+      month < 1 || month > 12   ||
+      day < 1   || day > month_days[month - 1] ||
+      (month == 2 && day == 29 && (year % 4 || (year % 100 == 0 && year % 400))) ||
+      hour > 23 || minute > 59 || second > 59)
+    return false;
+
+  long long seconds = daysFromCivil (year, month, day) * 86400LL
+                    + hour * 3600 + minute * 60 + second;
+  epoch = std::to_string (seconds);
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Converts an epoch string to the wire date format, YYYYMMDDTHHMMSSZ, without
+// going through Datetime.  Only plain digit strings from 1980 onwards take this
+// path, because Datetime interprets smaller numbers as other date formats.
+bool composeISO (const std::string& epoch, std::string& iso)
+{
+  if (epoch.length () < 9 ||
+      epoch.length () > 11)
+    return false;
+
+  long long seconds = 0;
+  for (auto c : epoch)
+  {
+    if (c < '0' || c > '9')
+      return false;
+
+    seconds = seconds * 10 + (c - '0');
+  }
+
+  if (seconds < 315532800)
+    return false;
+
+  long year;
+  unsigned month, day;
+  civilFromDays ((long) (seconds / 86400), year, month, day);
+  if (year > 9999)
+    return false;
+
+  unsigned rest   = (unsigned) (seconds % 86400);
+  unsigned hour   = rest / 3600;
+  unsigned minute = rest / 60 % 60;
+  unsigned second = rest % 60;
+
+  char buffer[16] = {
+    (char) ('0' + year / 1000),  (char) ('0' + year / 100 % 10),
+    (char) ('0' + year / 10 % 10), (char) ('0' + year % 10),
+    (char) ('0' + month / 10),   (char) ('0' + month % 10),
+    (char) ('0' + day / 10),     (char) ('0' + day % 10),
+    'T',
+    (char) ('0' + hour / 10),    (char) ('0' + hour % 10),
+    (char) ('0' + minute / 10),  (char) ('0' + minute % 10),
+    (char) ('0' + second / 10),  (char) ('0' + second % 10),
+    'Z'
+  };
+
+  iso.assign (buffer, sizeof (buffer));
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Converts a canonical UUID, 36 characters of lower-case hex digits and dashes
+// (8-4-4-4-12), to its 128-bit value.  Returns false for anything else.  Only
+// the lower-case form is accepted, so that two UUIDs have equal values exactly
+// when their text is equal, and so the values can stand in for the text.
+bool parseUUID (const std::string& text, UUID128& id)
+{
+  // Maps '0'-'9' and 'a'-'f' to their value, and everything else to 0xFF.
+  static const struct HexTable
+  {
+    unsigned char value[256];
+    HexTable ()
+    {
+      memset (value, 0xFF, sizeof (value));
+      for (int i = 0; i < 10; ++i) value['0' + i] = i;
+      for (int i = 0; i < 6;  ++i) value['a' + i] = 10 + i;
+    }
+  } hex;
+
+  if (text.length () != 36 ||
+      text[8]  != '-'      ||
+      text[13] != '-'      ||
+      text[18] != '-'      ||
+      text[23] != '-')
+    return false;
+
+  // Offsets of the 32 hex digits, skipping the dashes.
+  static const unsigned char offsets[32] = {
+     0,  1,  2,  3,  4,  5,  6,  7,
+     9, 10, 11, 12, 14, 15, 16, 17,
+    19, 20, 21, 22, 24, 25, 26, 27,
+    28, 29, 30, 31, 32, 33, 34, 35
+  };
+
+  auto bytes = (const unsigned char*) text.data ();
+  uint64_t words[2] = {0, 0};
+  unsigned char invalid = 0;
+  for (int i = 0; i < 32; ++i)
+  {
+    auto nibble = hex.value[bytes[offsets[i]]];
+    invalid |= nibble;
+    words[i / 16] = (words[i / 16] << 4) | (nibble & 0x0F);
+  }
+
+  // Any non-hex character sets the high bits.
+  if (invalid & 0xF0)
+    return false;
+
+  id.high = words[0];
+  id.low  = words[1];
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Verifies that data is well-formed UTF-8, per RFC 3629: no overlong forms, no
+// surrogates, nothing beyond U+10FFFF, and no truncated sequences.  Runs of
+// ASCII, which is nearly all of a sync payload, are skipped 16 bytes at a time
+// with SSE2, or 8 bytes at a time without it.
+bool validUTF8 (const char* data, size_t length)
+{
+  auto bytes = (const unsigned char*) data;
+  size_t i = 0;
+
+  while (i < length)
+  {
+#ifdef __SSE2__
+    while (i + 16 <= length &&
+           _mm_movemask_epi8 (_mm_loadu_si128 ((const __m128i*) (bytes + i))) == 0)
+      i += 16;
+#else
+    while (i + 8 <= length)
+    {
+      uint64_t word;
+      memcpy (&word, bytes + i, sizeof (word));
+      if (word & 0x8080808080808080ULL)
+        break;
+
+      i += 8;
+    }
+#endif
+
+    if (i >= length)
+      break;
+
+    unsigned char c = bytes[i];
+    if (c < 0x80)
+    {
+      ++i;
+      continue;
+    }
+
+    // Number of continuation bytes, and the valid range of the first one, from
+    // Table 3-7 of the Unicode Standard.
+    size_t continuation;
+    unsigned char low  = 0x80;
+    unsigned char high = 0xBF;
+
+         if (c >= 0xC2 && c <= 0xDF) { continuation = 1;              }
+    else if (c == 0xE0)              { continuation = 2; low  = 0xA0; }
+    else if (c >= 0xE1 && c <= 0xEC) { continuation = 2;              }
+    else if (c == 0xED)              { continuation = 2; high = 0x9F; }
+    else if (c >= 0xEE && c <= 0xEF) { continuation = 2;              }
+    else if (c == 0xF0)              { continuation = 3; low  = 0x90; }
+    else if (c >= 0xF1 && c <= 0xF3) { continuation = 3;              }
+    else if (c == 0xF4)              { continuation = 3; high = 0x8F; }
+    else
+      return false;
+
+    if (length - i <= continuation ||
+        bytes[i + 1] < low         ||
+        bytes[i + 1] > high)
+      return false;
+
+    for (size_t k = 2; k <= continuation; ++k)
+      if ((bytes[i + k] & 0xC0) != 0x80)
+        return false;
+
+    i += continuation + 1;
+  }
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
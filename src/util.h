@@ -29,6 +29,9 @@
 
 #include <string>
 #include <vector>
+#include <sys/types.h>
+#include <stdint.h>
+#include <StringView.h>
 #if defined(FREEBSD) || defined(OPENBSD)
 #include <uuid.h>
 #else
@@ -40,6 +43,41 @@ void uuid_unparse_lower (uuid_t uu, char *out);
 #endif
 const std::string uuid ();
 
+// A UUID as a 128-bit value.
+struct UUID128
+{
+  uint64_t high;
+  uint64_t low;
+
+  bool operator== (const UUID128& other) const { return high == other.high && low == other.low; }
+  bool operator!= (const UUID128& other) const { return ! (*this == other); }
+};
+
+struct UUID128Hash
+{
+  size_t operator() (const UUID128& id) const { return (size_t) (id.high ^ (id.low * 0x9E3779B97F4A7C15ULL)); }
+};
+
+bool parseUUID (const std::string&, UUID128&);
+
+bool validUTF8 (const char*, size_t);
+
+bool parseISO (const std::string&, std::string&);
+bool composeISO (const std::string&, std::string&);
+
+bool syncFile (const std::string&, bool);
+bool syncDescriptor (int, bool);
+bool writeAll (int, const std::string&);
+off_t completeLength (int, off_t);
+bool sendDescriptor (int, int);
+int receiveDescriptor (int);
+
+void appendRecord (std::string&, const std::string&);
+bool nextRecord (const StringView&, size_t&, StringView&);
+
+bool compressPayload (const std::string&, std::string&);
+bool decompressPayload (const StringView&, std::string&, size_t);
+
 #ifndef HAVE_TIMEGM
   time_t timegm (struct tm *tm);
 #endif
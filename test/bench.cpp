@@ -0,0 +1,157 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2006 - 2018, Paul Beckingham, Federico Hernandez.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// http://www.opensource.org/licenses/mit-license.php
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <iomanip>
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+#include <JSON.h>
+#include <bench.h>
+
+// Every heap allocation made by the process is counted here, so that the
+// benchmarks can report allocations alongside time.
+static std::atomic <long> _allocations {0};
+
+////////////////////////////////////////////////////////////////////////////////
+void* operator new (size_t size)
+{
+  ++_allocations;
+  void* p = malloc (size ? size : 1);
+  if (! p)
+    throw std::bad_alloc ();
+
+  return p;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void* operator new[] (size_t size)
+{
+  return operator new (size);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void operator delete (void* p) noexcept
+{
+  free (p);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void operator delete[] (void* p) noexcept
+{
+  free (p);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Benchmark::Benchmark (const std::string& name)
+: _name (name)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Benchmark::~Benchmark ()
+{
+  report ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Measurements are accumulated, so a start/stop pair may be used many times
+// for the same name.
+void Benchmark::start (const std::string& name)
+{
+  auto m = _measurements.find (name);
+  if (m == _measurements.end ())
+  {
+    _order.push_back (name);
+    m = _measurements.insert (std::make_pair (name, measurement ())).first;
+  }
+
+  m->second.started_allocations = _allocations;
+  m->second.started             = std::chrono::steady_clock::now ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// A single start/stop pair may cover many operations, for example a loop over
+// a corpus, in which case the per-operation figures are averaged over them.
+void Benchmark::stop (const std::string& name, long operations /* = 1 */)
+{
+  auto now = std::chrono::steady_clock::now ();
+  auto m = _measurements.find (name);
+  if (m == _measurements.end ())
+    return;
+
+  ++m->second.count;
+  m->second.operations  += operations;
+  m->second.total_us    += std::chrono::duration <double, std::micro> (now - m->second.started).count ();
+  m->second.allocations += _allocations - m->second.started_allocations;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Results are written to stdout as one JSON object per benchmark:
+//
+//   {"benchmark":"<name>","results":[{"name":"<measurement>",
+//    "count":<n>,"operations":<n>,"total_us":<n>,"us_per_op":<n>,
+//    "allocations":<n>,"allocations_per_op":<n>}, ...]}
+void Benchmark::report ()
+{
+  if (! _order.size ())
+    return;
+
+  std::cout << "{\"benchmark\":\"" << json::encode (_name) << "\",\"results\":[";
+
+  int written = 0;
+  for (auto& name : _order)
+  {
+    auto& m = _measurements[name];
+    auto ops = m.operations ? m.operations : 1;
+
+    if (written++)
+      std::cout << ',';
+
+    std::cout << std::fixed << std::setprecision (3)
+              << "\n{\"name\":\"" << json::encode (name) << '"'
+              << ",\"count\":"              << m.count
+              << ",\"operations\":"         << m.operations
+              << ",\"total_us\":"           << m.total_us
+              << ",\"us_per_op\":"          << m.total_us / ops
+              << ",\"allocations\":"        << m.allocations
+              << ",\"allocations_per_op\":" << (double) m.allocations / ops
+              << '}';
+  }
+
+  std::cout << "]}\n";
+
+  _order.clear ();
+  _measurements.clear ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+long Benchmark::allocations ()
+{
+  return _allocations;
+}
+
+////////////////////////////////////////////////////////////////////////////////
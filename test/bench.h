@@ -0,0 +1,65 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2006 - 2018, Paul Beckingham, Federico Hernandez.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// http://www.opensource.org/licenses/mit-license.php
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef INCLUDED_BENCHMARK
+#define INCLUDED_BENCHMARK
+
+#include <map>
+#include <vector>
+#include <string>
+#include <chrono>
+
+class Benchmark
+{
+public:
+  Benchmark (const std::string&);
+  ~Benchmark ();
+
+  void start (const std::string&);
+  void stop (const std::string&, long operations = 1);
+  void report ();
+
+  static long allocations ();
+
+private:
+  struct measurement
+  {
+    long count                                     {0};
+    long operations                                {0};
+    double total_us                                {0.0};
+    long allocations                               {0};
+    std::chrono::steady_clock::time_point started  {};
+    long started_allocations                       {0};
+  };
+
+  std::string _name                                {""};
+  std::vector <std::string> _order                 {};
+  std::map <std::string, measurement> _measurements {};
+};
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
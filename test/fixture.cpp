@@ -0,0 +1,86 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2006 - 2018, Paul Beckingham, Federico Hernandez.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// http://www.opensource.org/licenses/mit-license.php
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cmake.h>
+#include <ConfigFile.h>
+#include <FS.h>
+#include <shared.h>
+#include <fixture.h>
+
+////////////////////////////////////////////////////////////////////////////////
+void create_account (
+  const std::string& root,
+  const std::string& org,
+  const std::string& user,
+  const std::string& key)
+{
+  Directory dir (root);
+  for (auto& d : {"orgs", org.c_str (), "users", key.c_str ()})
+  {
+    dir += d;
+    if (! dir.exists () && ! dir.create (0700))
+      throw std::string ("Could not create ") + dir._data;
+  }
+
+  File conf_file (dir._data + "/config");
+  conf_file.create (0600);
+
+  Config conf (conf_file._data);
+  conf.set ("user", user);
+  conf.save ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Msg sync_request (
+  const std::string& org,
+  const std::string& user,
+  const std::string& key,
+  const std::string& client,
+  const std::string& payload)
+{
+  Msg request;
+  request.set ("type",     "sync");
+  request.set ("protocol", "v1");
+  request.set ("org",      org);
+  request.set ("user",     user);
+  request.set ("key",      key);
+  request.set ("client",   client);
+  request.setPayload (payload);
+  return request;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::string sync_key (const Msg& response)
+{
+  std::string sync_key;
+  for (auto& line : split (response.getPayload (), '\n'))
+    if (line != "" && line[0] != '{')
+      sync_key = line;
+
+  return sync_key;
+}
+
+////////////////////////////////////////////////////////////////////////////////
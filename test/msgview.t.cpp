@@ -0,0 +1,94 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2010 - 2018, Göteborg Bit Factory.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// http://www.opensource.org/licenses/mit-license.php
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cmake.h>
+#include <string>
+#include <vector>
+#include <Msg.h>
+#include <MsgView.h>
+#include <test.h>
+
+////////////////////////////////////////////////////////////////////////////////
+// Parses input with both Msg and MsgView, and checks that they agree on the
+// error, or on every named header and the payload.
+static void parity (
+  UnitTest& t,
+  const std::string& input,
+  const std::vector <std::string>& names,
+  const std::string& label)
+{
+  Msg msg;
+  std::string msg_error;
+  try { msg.parse (input); }
+  catch (const std::string& e) { msg_error = e; }
+
+  MsgView view;
+  std::string view_error;
+  try { view.parse (input); }
+  catch (const std::string& e) { view_error = e; }
+
+  if (msg_error != "" || view_error != "")
+  {
+    t.is (view_error, msg_error, label + " error");
+    return;
+  }
+
+  std::string differ;
+  for (auto& name : names)
+    if (view.get (name).str () != msg.get (name))
+      differ += " " + name;
+
+  if (view.getPayload ().str () != msg.getPayload ())
+    differ += " payload";
+
+  t.is (differ, "", label);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int main (int, char**)
+{
+  UnitTest t (13);
+
+  std::vector <std::string> names {"type", "org", "user", "key", "client", "x", "y"};
+
+  parity (t, "type: sync\norg: Public\nuser: Alice\n\npayload",   names, "MsgView plain headers");
+  parity (t, "  type  :  sync  \n\n",                              names, "MsgView spaces trimmed");
+  parity (t, "type:\tsync\t\nx: 1\r\n\n",                          names, "MsgView tab and CR kept");
+  parity (t, "\fx\f: \f1\f\n\n",                                   names, "MsgView form feed kept");
+  parity (t, std::string ("x: a\0\n\ny", 8),                       names, "MsgView trailing NUL kept");
+  parity (t, std::string ("x: \0a\0\n\n\0payload\0", 17),          names, "MsgView NULs kept");
+  parity (t, "x: 1\nx: 2\ny: 3\n\n",                               names, "MsgView repeated header last wins");
+  parity (t, "x: a:b:c\n\n",                                       names, "MsgView value with colons");
+  parity (t, "x:\n\npayload\n\nmore",                              names, "MsgView empty value, payload with separator");
+  parity (t, "\n\npayload",                                        names, "MsgView no headers");
+  parity (t, "\nx: 1\n\n",                                         names, "MsgView leading blank line");
+  parity (t, "x: 1\nbad\n\n",                                      names, "MsgView header without colon");
+  parity (t, "x: 1\n",                                             names, "MsgView no separator");
+
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
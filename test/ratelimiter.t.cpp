@@ -0,0 +1,89 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2010 - 2018, Göteborg Bit Factory.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// http://www.opensource.org/licenses/mit-license.php
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cmake.h>
+#include <string>
+#include <RateLimiter.h>
+#include <test.h>
+
+////////////////////////////////////////////////////////////////////////////////
+int main (int, char**)
+{
+  UnitTest t (14);
+
+  RateLimiter off;
+  t.notok (off.enabled (),                   "RateLimiter unconfigured is disabled");
+  off.take ("a", 0.0);
+  t.is (off.wait ("a", 0.0), 0.0,            "RateLimiter disabled never waits");
+
+  // Two per second, with bursts of three.
+  RateLimiter limits;
+  limits.configure (2.0, 3.0);
+  t.ok (limits.enabled (),                   "RateLimiter configured is enabled");
+  t.is (limits.wait ("a", 100.0), 0.0,       "RateLimiter new key starts full");
+
+  limits.take ("a", 100.0);
+  limits.take ("a", 100.0);
+  limits.take ("a", 100.0);
+  t.is (limits.wait ("a", 100.0), 0.5,       "RateLimiter empty bucket waits 1/rate");
+  t.is (limits.wait ("b", 100.0), 0.0,       "RateLimiter keys are independent");
+  t.is (limits.wait ("a", 100.25), 0.25,     "RateLimiter refills with time");
+  t.is (limits.wait ("a", 100.5), 0.0,       "RateLimiter one token after 1/rate");
+
+  // A bucket refills to the burst size, and no further.
+  limits.take ("a", 200.0);
+  limits.take ("a", 200.0);
+  limits.take ("a", 200.0);
+  t.ok (limits.wait ("a", 200.0) > 0.0,      "RateLimiter refill capped at burst");
+
+  // Overdrawn by requests admitted together, a bucket delays the next.
+  limits.take ("a", 200.0);
+  t.is (limits.wait ("a", 200.0), 1.0,       "RateLimiter overdrawn bucket waits longer");
+
+  // Reconfiguring starts every bucket full.
+  limits.configure (2.0, 3.0);
+  t.is (limits.wait ("a", 200.0), 0.0,       "RateLimiter configure resets buckets");
+
+  // A burst below one token would admit nothing.
+  RateLimiter small;
+  small.configure (0.5, 0.0);
+  t.is (small.wait ("a", 0.0), 0.0,          "RateLimiter burst is at least one");
+  small.take ("a", 0.0);
+  t.is (small.wait ("a", 0.0), 2.0,          "RateLimiter slow rate waits 1/rate");
+
+  // Full buckets are pruned once there are many keys, and busy ones are kept.
+  RateLimiter many;
+  many.configure (1.0, 1.0);
+  many.take ("busy", 0.0);
+  for (int i = 0; i < 2000; ++i)
+    many.wait (std::to_string (i), 0.5);
+
+  t.is (many.wait ("busy", 0.5), 0.5,        "RateLimiter busy bucket survives pruning");
+
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,93 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2006 - 2018, Paul Beckingham, Federico Hernandez.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// http://www.opensource.org/licenses/mit-license.php
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cmake.h>
+#include <map>
+#include <thread>
+#include <vector>
+#include <Symbol.h>
+#include <test.h>
+
+////////////////////////////////////////////////////////////////////////////////
+int main (int, char**)
+{
+  UnitTest t (14);
+
+  Symbol status ("status");
+  Symbol same (std::string ("status"));
+  t.ok (status.interned (),                          "Symbol status interned");
+  t.ok (&status.str () == &same.str (),              "Symbol status shares one string");
+  t.ok (status == same,                              "Symbol status == status");
+  t.ok (status != Symbol ("modified"),               "Symbol status != modified");
+  t.ok (Symbol ("modified") < status,                "Symbol modified < status");
+  t.is (status.str (), "status",                     "Symbol str");
+
+  Symbol annotation ("annotation_1514764800");
+  t.notok (annotation.interned (),                   "Symbol annotation_ not interned");
+  t.ok (annotation == Symbol ("annotation_1514764800"), "Symbol owned == owned");
+
+  Symbol copy (annotation);
+  t.ok (&copy.str () != &annotation.str (),          "Symbol copy of owned owns a copy");
+  copy = status;
+  t.ok (copy == status && copy.interned (),          "Symbol assign interned over owned");
+
+  // Maps iterate alphabetically, as with std::string keys.
+  std::map <Symbol, std::string> data;
+  data["uuid"]        = "1";
+  data["description"] = "2";
+  data["annotation_1514764800"] = "3";
+  data["entry"]       = "4";
+  std::string order;
+  for (auto& i : data)
+    order += i.first.str () + ' ';
+  t.is (order, "annotation_1514764800 description entry uuid ", "Symbol map order");
+  t.ok (data.find ("entry") != data.end (),          "Symbol map find");
+
+  // Threads interning the same new names agree on one copy of each.
+  std::vector <const std::string*> seen (8);
+  std::vector <std::thread> threads;
+  for (int i = 0; i < 8; ++i)
+    threads.push_back (std::thread ([i, &seen] ()
+    {
+      for (int n = 0; n < 100; ++n)
+        Symbol (std::string ("uda") + std::to_string (n));
+
+      seen[i] = &Symbol ("uda42").str ();
+    }));
+
+  for (auto& thread : threads)
+    thread.join ();
+
+  bool agree = true;
+  for (auto s : seen)
+    agree = agree && s == seen[0];
+  t.ok (agree,                                       "Symbol concurrent interning agrees");
+  t.is (*seen[0], "uda42",                           "Symbol concurrent interning content");
+
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,211 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2006 - 2018, Paul Beckingham, Federico Hernandez.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// http://www.opensource.org/licenses/mit-license.php
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cmake.h>
+#include <iostream>
+#include <sstream>
+#include <map>
+#include <vector>
+#include <stdlib.h>
+#include <ConfigFile.h>
+#include <Datetime.h>
+#include <Daemon.h>
+#include <FS.h>
+#include <Log.h>
+#include <format.h>
+#include <Msg.h>
+#include <shared.h>
+#include <util.h>
+#include <taskd.h>
+#include <bench.h>
+#include <fixture.h>
+
+// Drives Daemon::handler directly, without TLS or a network, so that the cost
+// of each phase of a sync can be profiled in isolation.
+//
+//   sync.bench [<tasks> [<rounds>]]
+
+static Benchmark* bench = nullptr;
+
+// The phases that Daemon::handle_sync reports, and the scenarios that run
+// them.  Every measurement name is built before anything is timed, so that the
+// hook does not allocate inside the measurements.  Other phases are ignored.
+static const std::vector <std::string> phases {"parse_payload", "load_server_data",
+                                               "find_branch_point", "extract_subset",
+                                               "merge", "append", "generate_payload"};
+static const std::vector <std::string> scenarios {"init", "store", "merge", "poll"};
+static std::map <std::string, std::vector <std::string>> phase_names;
+static const std::vector <std::string>* current = nullptr;
+
+static const std::string org  = "Bench";
+static const std::string user = "bench";
+static std::string key;
+
+////////////////////////////////////////////////////////////////////////////////
+static void phase_hook (const char* name, bool entry)
+{
+  for (size_t i = 0; i < phases.size (); ++i)
+  {
+    if (phases[i] == name)
+    {
+      if (entry)
+        bench->start ((*current)[i]);
+      else
+        bench->stop ((*current)[i]);
+
+      return;
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static std::string task (const std::string& uuid, int n, int revision)
+{
+  std::stringstream out;
+  out << "{\"description\":\"Benchmark task " << n << " revision " << revision << "\","
+      << "\"entry\":\"" << Datetime (1514764800 + n).toISO () << "\","
+      << "\"modified\":\"" << Datetime (1514764800 + n + revision * 3600).toISO () << "\","
+      << "\"project\":\"bench\","
+      << "\"status\":\"pending\","
+      << "\"tags\":[\"one\",\"two\"],"
+      << "\"uuid\":\"" << uuid << "\"}";
+  return out.str ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Sends one sync request through the handler, and returns the new sync key.
+static std::string sync (
+  Daemon& daemon,
+  const std::string& name,
+  const std::string& payload,
+  bool init = false)
+{
+  auto request = sync_request (org, user, key, "sync.bench", payload);
+  if (init)
+    request.set ("subtype", "init");
+
+  auto input = request.serialize ();
+  std::string output;
+
+  current = &phase_names.at (name);
+  bench->start (name);
+  daemon.handler (input, output);
+  bench->stop (name);
+
+  Msg response;
+  response.parse (output);
+  auto code = response.get ("code");
+  if (code != "200" && code != "201")
+    throw format ("{1} failed: {2} {3}", name, code, response.get ("status"));
+
+  return sync_key (response);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int main (int argc, char** argv)
+{
+  int tasks  = argc > 1 ? strtol (argv[1], NULL, 10) : 1000;
+  int rounds = argc > 2 ? strtol (argv[2], NULL, 10) : 5;
+
+  char root_template[] = "/tmp/taskd.sync.bench.XXXXXX";
+  if (! mkdtemp (root_template))
+  {
+    std::cerr << "Could not create a temporary data root.\n";
+    return 1;
+  }
+
+  std::string root = root_template;
+  int status = 0;
+
+  try
+  {
+    taskd_staticInitialize ();
+    key = uuid ();
+    create_account (root, org, user, key);
+
+    Config config;
+    config.set ("root", root);
+
+    Log log;
+    log.file ("/dev/null");
+
+    Daemon daemon (config);
+    daemon.setLog (&log);
+    daemon._db.setLog (&log);
+    daemon.setPhaseHook (phase_hook);
+
+    for (auto& s : scenarios)
+      for (auto& p : phases)
+        phase_names[s].push_back (s + "." + p);
+
+    Benchmark b (format ("sync.bench {1} tasks, {2} rounds", tasks, rounds));
+    bench = &b;
+
+    std::vector <std::string> uuids;
+    for (int i = 0; i < tasks; ++i)
+      uuids.push_back (uuid ());
+
+    // Initial upload of every task.
+    std::string payload;
+    for (int i = 0; i < tasks; ++i)
+      payload += task (uuids[i], i, 0) + "\n";
+
+    auto base_key = sync (daemon, "init", payload, true);
+
+    for (int round = 0; round < rounds; ++round)
+    {
+      // Half the tasks are modified, and stored without conflict.
+      payload = "";
+      for (int i = 0; i < tasks; i += 2)
+        payload += task (uuids[i], i, 2 * round + 1) + "\n";
+      sync (daemon, "store", payload + base_key + "\n");
+
+      // A second client modifies the same tasks from the same base, and so
+      // every one of them must be merged.
+      payload = "";
+      for (int i = 0; i < tasks; i += 2)
+        payload += task (uuids[i], i, 2 * round + 2) + "\n";
+      base_key = sync (daemon, "merge", payload + base_key + "\n");
+
+      // A client that is up to date polls for changes.
+      sync (daemon, "poll", base_key + "\n");
+    }
+
+    b.report ();
+    bench = nullptr;
+  }
+
+  catch (const std::string& error)
+  {
+    std::cerr << error << '\n';
+    status = 1;
+  }
+
+  Directory (root).remove ();
+  return status;
+}
+
+////////////////////////////////////////////////////////////////////////////////
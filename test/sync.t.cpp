@@ -0,0 +1,239 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2010 - 2018, Göteborg Bit Factory.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// http://www.opensource.org/licenses/mit-license.php
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cmake.h>
+#include <iostream>
+#include <stdlib.h>
+#include <map>
+#include <ConfigFile.h>
+#include <Daemon.h>
+#include <JSON.h>
+#include <Task.h>
+#include <FS.h>
+#include <Log.h>
+#include <format.h>
+#include <Msg.h>
+#include <shared.h>
+#include <util.h>
+#include <taskd.h>
+#include <test.h>
+#include <fixture.h>
+
+// Drives Daemon::handler directly, without TLS or a network, through
+// successive syncs of one account.
+
+static const std::string org  = "Test";
+static const std::string user = "test";
+static std::string key;
+
+////////////////////////////////////////////////////////////////////////////////
+// Sends one v1 sync request through the handler.
+static Msg sync (Daemon& daemon, const std::string& payload, bool delta = false)
+{
+  auto request = sync_request (org, user, key, "sync.t", payload);
+  if (delta)
+    request.set ("delta", "on");
+
+  std::string output;
+  daemon.handler (request.serialize (), output);
+
+  Msg response;
+  response.parse (output);
+  return response;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// A task, optionally with a priority and a project, modified on the given day
+// of January 2018, 1 to 9.
+static std::string task (
+  const std::string& uuid,
+  const std::string& description,
+  int day = 1,
+  const std::string& priority = "",
+  const std::string& project = "")
+{
+  return "{\"description\":\"" + description + "\","
+          "\"entry\":\"20180101T000000Z\","
+          "\"modified\":\"2018010" + std::to_string (day) + "T000000Z\","
+        + (priority != "" ? "\"priority\":\"" + priority + "\"," : "")
+        + (project  != "" ? "\"project\":\""  + project  + "\"," : "")
+        + "\"status\":\"pending\","
+          "\"uuid\":\"" + uuid + "\"}";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Applies the task records of a delta response to the client's tasks, the way
+// a client does: a full task replaces, and a delta patches.
+static void apply (const Msg& response, std::map <std::string, Task>& tasks)
+{
+  for (auto& line : split (response.getPayload (), '\n'))
+  {
+    if (line == "" || line[0] != '{')
+      continue;
+
+    json::value* root = json::parse (line);
+    auto record = (json::object*) root;
+    auto delta = record->_data.find ("delta");
+    if (delta == record->_data.end ())
+    {
+      Task full (line);
+      tasks[full.get ("uuid")] = full;
+    }
+    else
+    {
+      auto uuid = json::decode (((json::string*) record->_data["uuid"])->_data);
+      Task changes ((json::object*) delta->second);
+      auto& base = tasks[uuid];
+      for (auto& att : changes.data)
+        base.data[att.first] = att.second;
+
+      for (auto& att : ((json::array*) record->_data["remove"])->_data)
+        base.data.erase (json::decode (((json::string*) att)->_data));
+    }
+
+    delete root;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Counts the records in a response that refer to the UUID.
+static int records (const Msg& response, const std::string& uuid)
+{
+  int count = 0;
+  for (auto& line : split (response.getPayload (), '\n'))
+    if (line != "" && line[0] == '{' && line.find (uuid) != std::string::npos)
+      ++count;
+
+  return count;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int main (int, char**)
+{
+  UnitTest t (20);
+
+  char root_template[] = "/tmp/taskd.sync.t.XXXXXX";
+  if (! mkdtemp (root_template))
+  {
+    t.fail ("Could not create a temporary data root");
+    return 0;
+  }
+
+  std::string root = root_template;
+
+  try
+  {
+    taskd_staticInitialize ();
+    key = uuid ();
+    create_account (root, org, user, key);
+
+    Config config;
+    config.set ("root", root);
+
+    Log log;
+    log.file ("/dev/null");
+
+    Daemon daemon (config);
+    daemon.setLog (&log);
+    daemon._db.setLog (&log);
+
+    auto one = "a360fc44-315c-4366-b70c-ea7e7520b749";
+    auto two = "b5a2b39c-8b2c-4d6c-9a8b-cf3b7b1e6a01";
+
+    // Two syncs that each append to tx.data.
+    auto first = sync (daemon, task (one, "one") + "\n");
+    t.is (first.get ("code"), "200",                       "sync: first store 200");
+    auto first_key = sync_key (first);
+
+    auto second = sync (daemon, task (two, "two") + "\n" + first_key + "\n");
+    t.is (second.get ("code"), "200",                      "sync: second store into the same user 200");
+    auto second_key = sync_key (second);
+    t.ok (second_key != "" && second_key != first_key,     "sync: second store issues a new key");
+
+    std::vector <std::string> lines;
+    File::read (format ("{1}/orgs/{2}/users/{3}/tx.data", root, org, key), lines);
+    t.is (lines.size (), (size_t) 4,                       "sync: tx.data holds both tasks and both keys");
+
+    // A client at the first key receives the second task.
+    auto behind = sync (daemon, first_key + "\n");
+    t.is (behind.get ("code"), "200",                      "sync: client behind 200");
+    t.ok (behind.getPayload ().find (two) != std::string::npos, "sync: client behind receives the second task");
+
+    // A client that is up to date sees no change.
+    auto current = sync (daemon, second_key + "\n");
+    t.is (current.get ("code"), "201",                     "sync: client up to date 201");
+
+    // Deltas.  Clients A and B start from the same two tasks.
+    auto t1 = "c1b5e4a2-3d6f-4e8a-9b0c-1d2e3f4a5b6c";
+    auto t2 = "d2c6f5b3-4e7a-4f9b-8c1d-2e3f4a5b6c7d";
+    auto t3 = "e3d7a6c4-5f8b-4a0c-9d2e-3f4a5b6c7d8e";
+    auto k0 = sync_key (sync (daemon, task (t1, "one") + "\n" + task (t2, "two") + "\n" + second_key + "\n"));
+
+    std::map <std::string, Task> client_a;
+    client_a[t1] = Task (task (t1, "one"));
+    client_a[t2] = Task (task (t2, "two"));
+
+    // B sets priority:H on the first task, a project on the second, and adds a
+    // third.
+    auto k1 = sync_key (sync (daemon, task (t1, "one", 2, "H") + "\n" + task (t2, "two", 2, "", "x") + "\n" + k0 + "\n"));
+    auto k2 = sync_key (sync (daemon, task (t3, "three", 2) + "\n" + k1 + "\n"));
+    t.ok (k1 != "" && k2 != "",                            "delta: B stores changes");
+
+    // A, still at k0, later sets priority:L on the first task, which must be
+    // merged with B's change.  The later change wins.
+    client_a[t1] = Task (task (t1, "one", 3, "L"));
+    auto merge = sync (daemon, task (t1, "one", 3, "L") + "\n" + k0 + "\n", true);
+    t.is (merge.get ("code"), "200",                       "delta: merge 200");
+    t.is (merge.get ("delta"), "on",                       "delta: response is delta encoded");
+    t.is (records (merge, t1), 1,                          "delta: merged task sent once, as its merged delta");
+    apply (merge, client_a);
+    t.is (client_a[t1].get ("priority"), "L",              "delta: merged task keeps the client's later priority");
+    t.is (client_a[t2].get ("project"), "x",               "delta: subset task patched with the project");
+    t.is (client_a[t3].get ("description"), "three",       "delta: task new to the client sent in full");
+    t.is (client_a.size (), (size_t) 3,                    "delta: client holds three tasks");
+    auto k3 = sync_key (merge);
+
+    // B removes the project, and A receives the removal as a delta.
+    auto k4 = sync_key (sync (daemon, task (t2, "two", 4) + "\n" + k2 + "\n"));
+    auto removal = sync (daemon, k3 + "\n", true);
+    t.ok (k4 != "",                                        "delta: B removes the project");
+    t.ok (removal.getPayload ().find ("\"remove\":[\"project\"]") != std::string::npos, "delta: removal sent as a remove");
+    apply (removal, client_a);
+    t.is (client_a[t2].get ("project"), "",                "delta: removed project applied");
+    t.is (client_a[t1].get ("priority"), "L",              "delta: merged task unchanged by a later poll");
+    t.is (sync_key (removal), k4,                          "delta: client brought up to date");
+  }
+
+  catch (const std::string& error)
+  {
+    t.diag (error);
+  }
+
+  Directory (root).remove ();
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
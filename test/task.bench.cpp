@@ -0,0 +1,212 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2006 - 2018, Paul Beckingham, Federico Hernandez.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// http://www.opensource.org/licenses/mit-license.php
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cmake.h>
+#include <iostream>
+#include <sstream>
+#include <stdlib.h>
+#include <ConfigFile.h>
+#include <Datetime.h>
+#include <Daemon.h>
+#include <Log.h>
+#include <Task.h>
+#include <format.h>
+#include <util.h>
+#include <taskd.h>
+#include <bench.h>
+
+// Microbenchmarks for the Task hot paths used by a sync.
+//
+//   task.bench [<tasks> [<iterations>]]
+
+// Results are accumulated here so the compiler cannot discard the work.
+static volatile size_t sink = 0;
+
+////////////////////////////////////////////////////////////////////////////////
+// A corpus of minimal, typical and heavily decorated tasks, as JSON.
+static std::vector <std::string> corpus (int count)
+{
+  std::vector <std::string> tasks;
+  for (int i = 0; i < count; ++i)
+  {
+    auto entry = Datetime (1514764800 + i * 60).toISO ();
+    std::stringstream out;
+    out << "{\"description\":\"Task number " << i << ", with \\\"quotes\\\" and [brackets]\","
+        << "\"entry\":\"" << entry << "\","
+        << "\"modified\":\"" << entry << "\","
+        << "\"status\":\"" << (i % 3 ? "pending" : "completed") << "\",";
+
+    switch (i % 3)
+    {
+    case 0:
+      out << "\"end\":\"" << entry << "\",";
+      break;
+
+    case 1:
+      out << "\"project\":\"home.garden\","
+          << "\"due\":\"" << Datetime (1514764800 + i * 3600).toISO () << "\","
+          << "\"tags\":[\"outside\",\"weekend\"],";
+      break;
+
+    case 2:
+      out << "\"project\":\"work.release\","
+          << "\"priority\":\"H\","
+          << "\"due\":\"" << Datetime (1514764800 + i * 3600).toISO () << "\","
+          << "\"wait\":\"" << Datetime (1514764800 + i * 1800).toISO () << "\","
+          << "\"recur\":\"weekly\","
+          << "\"depends\":\"" << uuid () << "," << uuid () << "\","
+          << "\"tags\":[\"next\",\"review\",\"blocked\",\"release\"],"
+          << "\"estimate\":\"4h\","
+          << "\"annotations\":["
+          << "{\"entry\":\"" << entry << "\",\"description\":\"First note\"},"
+          << "{\"entry\":\"" << Datetime (1514764860 + i * 60).toISO () << "\",\"description\":\"Second note\"}],";
+      break;
+    }
+
+    out << "\"uuid\":\"" << uuid () << "\"}";
+    tasks.push_back (out.str ());
+  }
+
+  return tasks;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int main (int argc, char** argv)
+{
+  int count      = argc > 1 ? strtol (argv[1], NULL, 10) : 1000;
+  int iterations = argc > 2 ? strtol (argv[2], NULL, 10) : 10;
+  if (count < 1)
+    count = 1;
+
+  taskd_staticInitialize ();
+
+  auto json = corpus (count);
+
+  std::vector <Task> tasks;
+  std::vector <std::string> ff4;
+  for (auto& line : json)
+  {
+    tasks.push_back (Task (line));
+    ff4.push_back (tasks.back ().composeF4 ());
+  }
+
+  Config config;
+  Log log;
+  log.file ("/dev/null");
+
+  Daemon daemon (config);
+  daemon.setLog (&log);
+
+  Benchmark bench (format ("task.bench {1} tasks, {2} iterations", count, iterations));
+
+  for (int i = 0; i < iterations; ++i)
+  {
+    bench.start ("Task::parse JSON");
+    for (auto& line : json)
+    {
+      Task t (line);
+      sink += t.data.size ();
+    }
+    bench.stop ("Task::parse JSON", json.size ());
+
+    bench.start ("Task::parse FF4");
+    for (auto& line : ff4)
+    {
+      Task t (line);
+      sink += t.data.size ();
+    }
+    bench.stop ("Task::parse FF4", ff4.size ());
+
+    bench.start ("Task::composeJSON");
+    for (auto& t : tasks)
+      sink += t.composeJSON ().length ();
+    bench.stop ("Task::composeJSON", tasks.size ());
+
+    auto copies = tasks;
+    bench.start ("Task::validate");
+    for (auto& t : copies)
+      t.validate ();
+    bench.stop ("Task::validate", copies.size ());
+
+    bench.start ("Task::getTags");
+    for (auto& t : tasks)
+      sink += t.getTags ().size ();
+    bench.stop ("Task::getTags", tasks.size ());
+
+    copies = tasks;
+    bench.start ("Task::addTag");
+    for (auto& t : copies)
+    {
+      t.addTag ("review");
+      t.addTag ("extra");
+    }
+    bench.stop ("Task::addTag", 2 * copies.size ());
+
+    // Each task is patched from its original to a modified form.
+    copies = tasks;
+    std::vector <Task> modified = tasks;
+    for (auto& t : modified)
+    {
+      t.set ("description", "Modified description");
+      t.set ("priority", "L");
+      t.remove ("project");
+    }
+
+    bench.start ("Daemon::patch");
+    for (unsigned int t = 0; t < copies.size (); ++t)
+      daemon.patch (copies[t], tasks[t], modified[t]);
+    bench.stop ("Daemon::patch", copies.size ());
+
+    // Interleaved client and server modifications of one task.
+    std::vector <Task> left;
+    std::vector <Task> right;
+    for (int t = 0; t < 20; ++t)
+    {
+      Task l (tasks[0]);
+      l.set ("description", format ("Client revision {1}", t));
+      l.set ("modified", (int) (1514764800 + 2 * t));
+      left.push_back (l);
+
+      Task r (tasks[0]);
+      r.set ("priority", t % 2 ? "H" : "L");
+      r.set ("modified", (int) (1514764801 + 2 * t));
+      right.push_back (r);
+    }
+
+    bench.start ("Daemon::merge_sort");
+    for (int m = 0; m < 100; ++m)
+    {
+      Task combined (tasks[0]);
+      daemon.merge_sort (left, right, combined);
+      sink += combined.data.size ();
+    }
+    bench.stop ("Daemon::merge_sort", 100);
+  }
+
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
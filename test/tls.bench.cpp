@@ -0,0 +1,176 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2006 - 2018, Paul Beckingham, Federico Hernandez.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// http://www.opensource.org/licenses/mit-license.php
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cmake.h>
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <stdlib.h>
+#include <TLSServer.h>
+#include <TLSClient.h>
+#include <format.h>
+#include <bench.h>
+
+// Measures the server side of a TLS transaction over loopback: the accept and
+// handshake, then receipt and transmission of small and large payloads.
+//
+//   tls.bench [<connections> [<port>]]
+//
+// The test certificates are expected in ./test_certs.  Note that allocations
+// are counted process-wide, and so include those made by the client.
+
+static const std::string certs = "test_certs/";
+
+// The first error, from either thread.
+static std::mutex error_mutex;
+static std::string error;
+
+////////////////////////////////////////////////////////////////////////////////
+static void fail (const std::string& message)
+{
+  std::lock_guard <std::mutex> lock (error_mutex);
+  if (error == "")
+    error = message;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static bool failed ()
+{
+  std::lock_guard <std::mutex> lock (error_mutex);
+  return error != "";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Connections alternate between the small and large payloads, and each size is
+// measured separately, so that neither widens the other's distribution.
+static void serve (
+  TLSServer& server,
+  Benchmark& bench,
+  int connections)
+{
+  const std::string recv[] = {"TLSTransaction::recv 1KB", "TLSTransaction::recv 1MB"};
+  const std::string send[] = {"TLSTransaction::send 1KB", "TLSTransaction::send 1MB"};
+
+  try
+  {
+    for (int i = 0; i < connections; ++i)
+    {
+      TLSTransaction tx;
+      tx.trust (server.trust ());
+
+      bench.start ("TLSTransaction::init");
+      while (! server.accept (tx))
+        server.ready (1000);
+      bench.stop ("TLSTransaction::init");
+
+      std::string input;
+      bench.start (recv[i % 2]);
+      tx.recv (input);
+      bench.stop (recv[i % 2]);
+
+      bench.start (send[i % 2]);
+      tx.send (input);
+      bench.stop (send[i % 2]);
+
+      tx.bye ();
+    }
+  }
+
+  catch (const std::string& e)
+  {
+    fail (e);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int main (int argc, char** argv)
+{
+  int connections  = argc > 1 ? strtol (argv[1], NULL, 10) : 200;
+  std::string port = argc > 2 ? argv[2] : "53590";
+
+  // Half the connections carry a small request, half a large one.
+  std::string small (1024, 'x');
+  std::string large (1024 * 1024, 'x');
+
+  Benchmark bench (format ("tls.bench {1} connections", connections));
+
+  try
+  {
+    TLSServer server;
+    server.trust (TLSServer::allow_all);
+    server.init (certs + "ca.cert.pem",
+                 "",
+                 certs + "server.cert.pem",
+                 certs + "server.key.pem");
+    server.bind ("127.0.0.1", port, "IPv4");
+    server.listen ();
+
+    std::thread listener (serve, std::ref (server), std::ref (bench), connections);
+
+    try
+    {
+      for (int i = 0; i < connections && ! failed (); ++i)
+      {
+        TLSClient client;
+        client.trust (TLSClient::allow_all);
+        client.init (certs + "ca.cert.pem",
+                     certs + "client.cert.pem",
+                     certs + "client.key.pem");
+        client.connect ("127.0.0.1", port);
+        client.send (i % 2 ? large : small);
+
+        std::string response;
+        client.recv (response);
+        client.bye ();
+      }
+    }
+
+    catch (const std::string& e)
+    {
+      // The listener may be blocked in accept, and is abandoned.
+      std::cerr << e << '\n';
+      listener.detach ();
+      return 1;
+    }
+
+    listener.join ();
+  }
+
+  catch (const std::string& e)
+  {
+    fail (e);
+  }
+
+  if (error != "")
+  {
+    std::cerr << error << '\n';
+    return 1;
+  }
+
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,223 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2010 - 2018, Göteborg Bit Factory.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// http://www.opensource.org/licenses/mit-license.php
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cmake.h>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <TLSServer.h>
+#include <TLSClient.h>
+#include <util.h>
+#include <test.h>
+
+// Round trips payloads through TLSClient and TLSTransaction over loopback.
+// The test certificates are expected in ./test_certs.
+
+static const std::string certs = "test_certs/";
+static const std::string port  = "53591";
+static const std::string port6 = "53592";
+
+////////////////////////////////////////////////////////////////////////////////
+// Echoes each request back to the client, and records the client addresses.
+static void echo (
+  TLSServer& server,
+  int connections,
+  std::vector <std::string>& received,
+  std::vector <std::string>& addresses)
+{
+  try
+  {
+    for (int i = 0; i < connections; ++i)
+    {
+      TLSTransaction tx;
+      tx.trust (server.trust ());
+      while (! server.accept (tx))
+        server.ready (1000);
+
+      std::string address;
+      int client_port;
+      tx.getClient (address, client_port);
+      addresses.push_back (address);
+
+      std::string input;
+      tx.recv (input);
+      received.push_back (input);
+      tx.send (input);
+      tx.bye ();
+    }
+  }
+
+  catch (const std::string& error)
+  {
+    std::cerr << error << '\n';
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int main (int, char**)
+{
+  std::vector <std::string> payloads;
+  payloads.push_back ("type: sync\n\n{\"description\":\"text\"}\n");
+  payloads.push_back (std::string ("\0\0\0\x05hello\0", 10));
+
+  // Protocol v2 records begin with a length prefix, which begins with NUL.
+  std::string records;
+  appendRecord (records, "{\"description\":\"one\"}");
+  appendRecord (records, "a360fc44-315c-4366-b70c-ea7e7520b749");
+  payloads.push_back ("protocol: v2\ntype: sync\n\n" + records + "\n");
+
+  // Larger than a single TLS record.
+  std::string large;
+  for (int i = 0; i < 100000; ++i)
+    large += (char) (i % 256);
+  payloads.push_back (large);
+
+#ifdef HAVE_LIBZ
+  std::string packed;
+  compressPayload (large, packed);
+  payloads.push_back (packed);
+#endif
+
+  UnitTest t (2 * payloads.size () + 3);
+
+  try
+  {
+    TLSServer server;
+    server.trust (TLSServer::allow_all);
+    server.init (certs + "ca.cert.pem",
+                 "",
+                 certs + "server.cert.pem",
+                 certs + "server.key.pem");
+    server.bind ("127.0.0.1", port, "IPv4");
+    server.listen ();
+
+    std::vector <std::string> received;
+    std::vector <std::string> addresses;
+    std::thread listener (echo, std::ref (server), payloads.size (), std::ref (received), std::ref (addresses));
+
+    std::vector <std::string> responses;
+    try
+    {
+      for (auto& payload : payloads)
+      {
+        TLSClient client;
+        client.trust (TLSClient::allow_all);
+        client.init (certs + "ca.cert.pem",
+                     certs + "client.cert.pem",
+                     certs + "client.key.pem");
+        client.connect ("127.0.0.1", port);
+        client.send (payload);
+
+        std::string response;
+        client.recv (response);
+        client.bye ();
+        responses.push_back (response);
+      }
+    }
+
+    catch (const std::string& error)
+    {
+      // The listener may be blocked in accept, and is abandoned.
+      t.diag (error);
+      listener.detach ();
+      return 1;
+    }
+
+    listener.join ();
+
+    for (size_t i = 0; i < payloads.size (); ++i)
+    {
+      t.ok (i < received.size () && received[i] == payloads[i], "TLSTransaction::recv payload " + std::to_string (i));
+      t.ok (responses[i] == payloads[i],                          "TLSClient::recv payload " + std::to_string (i));
+    }
+
+    t.is (addresses.size () ? addresses[0] : "", "127.0.0.1",  "TLSTransaction::getClient IPv4");
+  }
+
+  catch (const std::string& error)
+  {
+    t.diag (error);
+  }
+
+  // A dual-stack listener sees IPv6 clients by their IPv6 address, and IPv4
+  // clients by their IPv4 address rather than the mapped IPv6 one.
+  try
+  {
+    TLSServer server;
+    server.trust (TLSServer::allow_all);
+    server.init (certs + "ca.cert.pem",
+                 "",
+                 certs + "server.cert.pem",
+                 certs + "server.key.pem");
+    server.bind ("::", port6, "IPv6");
+    server.listen ();
+
+    std::vector <std::string> hosts {"::1", "127.0.0.1"};
+    std::vector <std::string> received;
+    std::vector <std::string> addresses;
+    std::thread listener (echo, std::ref (server), hosts.size (), std::ref (received), std::ref (addresses));
+
+    try
+    {
+      for (auto& host : hosts)
+      {
+        TLSClient client;
+        client.trust (TLSClient::allow_all);
+        client.init (certs + "ca.cert.pem",
+                     certs + "client.cert.pem",
+                     certs + "client.key.pem");
+        client.connect (host, port6);
+        client.send ("type: statistics\n\n");
+
+        std::string response;
+        client.recv (response);
+        client.bye ();
+      }
+    }
+
+    catch (const std::string& error)
+    {
+      t.diag (error);
+      listener.detach ();
+      return 1;
+    }
+
+    listener.join ();
+
+    t.is (addresses.size () > 0 ? addresses[0] : "", "::1",       "TLSTransaction::getClient IPv6");
+    t.is (addresses.size () > 1 ? addresses[1] : "", "127.0.0.1", "TLSTransaction::getClient IPv4-mapped");
+  }
+
+  catch (const std::string& error)
+  {
+    t.skip ("TLSTransaction::getClient IPv6 (" + error + ")");
+    t.skip ("TLSTransaction::getClient IPv4-mapped");
+  }
+
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
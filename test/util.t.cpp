@@ -0,0 +1,181 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2010 - 2018, Göteborg Bit Factory.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// http://www.opensource.org/licenses/mit-license.php
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cmake.h>
+#include <iostream>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <util.h>
+#include <test.h>
+
+////////////////////////////////////////////////////////////////////////////////
+int main (int, char**)
+{
+  UnitTest t (54);
+
+  // bool parseISO (const std::string&, std::string&);
+  std::string epoch;
+  t.ok    (parseISO ("19800101T000000Z", epoch),  "parseISO 19800101T000000Z");
+  t.is    (epoch, "315532800",                    "parseISO 19800101T000000Z --> 315532800");
+  t.ok    (parseISO ("20180504T123456Z", epoch),  "parseISO 20180504T123456Z");
+  t.is    (epoch, "1525437296",                   "parseISO 20180504T123456Z --> 1525437296");
+  t.ok    (parseISO ("20200229T235959Z", epoch),  "parseISO 20200229T235959Z leap day");
+  t.notok (parseISO ("20190229T000000Z", epoch),  "parseISO 20190229T000000Z not a leap year");
+  t.notok (parseISO ("21000229T000000Z", epoch),  "parseISO 21000229T000000Z not a leap year");
+  t.notok (parseISO ("20181301T000000Z", epoch),  "parseISO 20181301T000000Z month out of range");
+  t.notok (parseISO ("20180504T123456",  epoch),  "parseISO 20180504T123456 local time falls back");
+  t.notok (parseISO ("2018-05-04T12:34:56Z", epoch), "parseISO extended format falls back");
+  t.notok (parseISO ("19700101T000000Z", epoch),  "parseISO 19700101T000000Z before 1980 falls back");
+
+  // bool composeISO (const std::string&, std::string&);
+  std::string iso;
+  t.ok    (composeISO ("315532800", iso),         "composeISO 315532800");
+  t.is    (iso, "19800101T000000Z",               "composeISO 315532800 --> 19800101T000000Z");
+  t.ok    (composeISO ("1525437296", iso),        "composeISO 1525437296");
+  t.is    (iso, "20180504T123456Z",               "composeISO 1525437296 --> 20180504T123456Z");
+  t.notok (composeISO ("20180504", iso),          "composeISO 20180504 falls back");
+
+  // bool parseUUID (const std::string&, UUID128&);
+  UUID128 id;
+  t.ok    (parseUUID ("a360fc44-315c-4366-b70c-ea7e7520b749", id), "parseUUID canonical");
+  t.ok    (id.high == 0xa360fc44315c4366ULL,      "parseUUID high word");
+  t.ok    (id.low  == 0xb70cea7e7520b749ULL,      "parseUUID low word");
+  t.notok (parseUUID ("A360FC44-315C-4366-B70C-EA7E7520B749", id), "parseUUID upper case is not canonical");
+  t.notok (parseUUID ("a360fc44-315c-4366-b70c-ea7e7520b74",  id), "parseUUID too short");
+  t.notok (parseUUID ("a360fc44x315c-4366-b70c-ea7e7520b749", id), "parseUUID misplaced dash");
+  t.notok (parseUUID ("a360fc44-315c-4366-b70c-ea7e7520b74g", id), "parseUUID non-hex digit");
+
+  // bool validUTF8 (const char*, size_t);
+  std::string text = "{\"description\":\"caf\xC3\xA9 \xE2\x82\xAC \xF0\x9F\x98\x80\"}";
+  t.ok    (validUTF8 (text.data (), text.length ()),  "validUTF8 mixed ASCII and multi-byte");
+  t.notok (validUTF8 ("\xC0\xAF", 2),                "validUTF8 overlong '/'");
+  t.notok (validUTF8 ("\xED\xA0\x80", 3),            "validUTF8 surrogate");
+  t.notok (validUTF8 ("\xF4\x90\x80\x80", 4),        "validUTF8 beyond U+10FFFF");
+  t.notok (validUTF8 (text.data (), text.length () - 4), "validUTF8 truncated sequence");
+
+  // bool sendDescriptor (int, int);
+  // int receiveDescriptor (int);
+  int channel[2];
+  int pipe_fds[2];
+  if (socketpair (AF_UNIX, SOCK_STREAM, 0, channel) == 0 &&
+      pipe (pipe_fds) == 0)
+  {
+    t.ok (sendDescriptor (channel[0], pipe_fds[1]),  "sendDescriptor pipe");
+    int received = receiveDescriptor (channel[1]);
+    t.ok (received != -1,                            "receiveDescriptor pipe");
+
+    char byte = 0;
+    if (write (received, "x", 1) != 1 ||
+        read (pipe_fds[0], &byte, 1) != 1)
+      byte = 0;
+    t.ok (byte == 'x',                               "receiveDescriptor usable descriptor");
+  }
+  else
+    t.fail ("socketpair or pipe failed");
+
+  // void appendRecord (std::string&, const std::string&);
+  // bool nextRecord (const StringView&, size_t&, StringView&);
+  std::string framed;
+  std::string binary ("a\0b\nc", 5);
+  appendRecord (framed, "{\"uuid\":\"a360fc44-315c-4366-b70c-ea7e7520b749\"}");
+  appendRecord (framed, "");
+  appendRecord (framed, binary);
+  appendRecord (framed, std::string (70000, 'x'));
+  t.is    (framed.substr (0, 4), std::string ("\0\0\0\x2f", 4), "appendRecord big-endian length prefix");
+
+  size_t offset = 0;
+  StringView record;
+  t.ok    (nextRecord (framed, offset, record),     "nextRecord 1");
+  t.is    (record.str (), "{\"uuid\":\"a360fc44-315c-4366-b70c-ea7e7520b749\"}", "nextRecord 1 round trip");
+  t.ok    (nextRecord (framed, offset, record),     "nextRecord 2");
+  t.ok    (record.empty (),                         "nextRecord 2 empty record");
+  t.ok    (nextRecord (framed, offset, record),     "nextRecord 3");
+  t.ok    (record.str () == binary,                 "nextRecord 3 binary round trip");
+  t.ok    (nextRecord (framed, offset, record),     "nextRecord 4");
+  t.ok    (record.str () == std::string (70000, 'x'), "nextRecord 4 round trip");
+  t.notok (nextRecord (framed, offset, record),     "nextRecord end of payload");
+
+  std::string newline = framed + "\n";
+  offset = framed.length ();
+  t.notok (nextRecord (newline, offset, record),    "nextRecord tolerates trailing newline");
+
+  std::string truncated = framed.substr (0, framed.length () - 1);
+  offset = 0;
+  bool threw = false;
+  try
+  {
+    while (nextRecord (truncated, offset, record))
+      ;
+  }
+  catch (const std::string&)
+  {
+    threw = true;
+  }
+  t.ok    (threw,                                   "nextRecord truncated record throws");
+
+  std::string short_length ("\0\0", 2);
+  offset = 0;
+  threw = false;
+  try
+  {
+    nextRecord (short_length, offset, record);
+  }
+  catch (const std::string&)
+  {
+    threw = true;
+  }
+  t.ok    (threw,                                   "nextRecord truncated length throws");
+
+  // bool compressPayload (const std::string&, std::string&);
+  // bool decompressPayload (const StringView&, std::string&, size_t);
+  std::string plain;
+  for (int i = 0; i < 1000; ++i)
+    plain += "{\"description\":\"task\",\"status\":\"pending\"}\n";
+  plain += std::string ("\0\x01\xFF", 3);
+
+#ifdef HAVE_LIBZ
+  std::string packed;
+  std::string unpacked;
+  t.ok    (compressPayload (plain, packed),                 "compressPayload");
+  t.ok    (packed.length () < plain.length (),              "compressPayload smaller");
+  t.ok    (packed.find ('\0') != std::string::npos,         "compressPayload output contains NUL");
+  t.ok    (decompressPayload (packed, unpacked, 0),         "decompressPayload");
+  t.ok    (unpacked == plain,                               "decompressPayload round trip, binary safe");
+  t.ok    (decompressPayload (packed + "\n", unpacked, 0),  "decompressPayload trailing newline");
+  t.ok    (unpacked == plain,                               "decompressPayload trailing newline round trip");
+  t.notok (decompressPayload (packed, unpacked, 1024),      "decompressPayload limit exceeded");
+  t.notok (decompressPayload (packed.substr (0, packed.length () / 2), unpacked, 0), "decompressPayload truncated");
+  t.notok (decompressPayload (plain, unpacked, 0),          "decompressPayload not compressed");
+#else
+  for (int i = 0; i < 10; ++i)
+    t.skip ("zlib not available");
+#endif
+
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////